@@ -0,0 +1,539 @@
+// --batch and --jobs: many silent games on worker threads, one result row
+// per seed, and the --bench-steps movement benchmark.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "engine_internal.h"
+#include "tools.h"
+
+typedef struct {
+    unsigned int seed;
+    char winner;
+    int round_count;
+    int movement_points[MAX_PLAYERS];
+} GameResult;
+
+// The games one interleaving worker has yet to start: seeds[next..end).
+// Idle workers steal the top half of another worker's range. next and end
+// only change under lock, through atomic stores, so other workers may
+// load them without it to pick a victim.
+typedef struct {
+    int next;
+    int end;
+    pthread_mutex_t lock;
+} InterleaveQueue;
+
+typedef struct {
+    const Board* board;
+    bool shared_board;
+    int interleave;
+    const unsigned int* seeds;
+    GameResult* results;
+    int num_games;
+    int next_game;
+    // Games that reached their result row; a worker that cannot get its
+    // board or slots plays none, and the batch fails if any are missing.
+    int played;
+    InterleaveQueue* queues;
+    int num_queues;
+    int next_queue;
+    uint64_t steals;
+    GameStats stats;
+    pthread_mutex_t lock;
+} BatchJob;
+
+static void* batch_worker(void* arg);
+static void interleave_worker(BatchJob* job);
+static int interleave_take(BatchJob* job, int worker);
+static void print_results(const GameResult* results, int num_games);
+static int run_batch(const Board* board, bool shared_board, int interleave, const unsigned int* seeds, int num_games, int num_threads, const char* stats_name);
+static unsigned int* load_jobs_from_file(const char* filename, int* num_games);
+
+static unsigned int* load_jobs_from_file(const char* filename, int* num_games) {
+    FILE* file = fopen(filename, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Cannot open %s\n", filename);
+        return NULL;
+    }
+    
+    int capacity = 64;
+    unsigned int* seeds = malloc(capacity * sizeof(unsigned int));
+    unsigned int seed;
+    *num_games = 0;
+    
+    while (seeds != NULL && fscanf(file, "%u", &seed) == 1) {
+        if (*num_games == capacity) {
+            capacity *= 2;
+            unsigned int* grown = realloc(seeds, capacity * sizeof(unsigned int));
+            if (grown == NULL) {
+                free(seeds);
+                seeds = NULL;
+                break;
+            }
+            seeds = grown;
+        }
+        seeds[(*num_games)++] = seed;
+    }
+    
+    fclose(file);
+    
+    if (seeds == NULL) {
+        fprintf(stderr, "Error: Out of memory reading %s\n", filename);
+    } else if (*num_games == 0) {
+        fprintf(stderr, "Error: No seeds found in %s\n", filename);
+        free(seeds);
+        seeds = NULL;
+    }
+    return seeds;
+}
+
+static void* batch_worker(void* arg) {
+    BatchJob* job = (BatchJob*)arg;
+    Board copy;
+    GameState game;
+    GameStats stats;
+    memset(&stats, 0, sizeof(stats));
+    int played = 0;
+    
+    if (job->interleave > 0) {
+        interleave_worker(job);
+        return NULL;
+    }
+    
+    // By default each game rolls its own cells from its seed, on a board
+    // private to the worker. A shared board is only ever read, so every
+    // worker plays on it directly.
+    const Board* board = job->board;
+    if (!job->shared_board) {
+        if (!maze_clone_board(&copy, job->board)) {
+            fprintf(stderr, "Error: Out of memory for a worker board\n");
+            return NULL;
+        }
+        copy.out = NULL;
+        board = &copy;
+    }
+    
+    while (true) {
+        pthread_mutex_lock(&job->lock);
+        int index = job->next_game++;
+        pthread_mutex_unlock(&job->lock);
+        
+        if (index >= job->num_games) break;
+        
+        if (!job->shared_board) {
+            maze_roll_board(&copy, job->seeds[index]);
+        }
+        maze_start_game(&game, board, job->seeds[index]);
+        game.log_level = MAZE_LOG_OFF;
+        maze_play_game(&game);
+        
+        GameResult* result = &job->results[index];
+        result->seed = job->seeds[index];
+        result->winner = game.winner;
+        result->round_count = game.round_count;
+        for (int i = 0; i < MAX_PLAYERS; i++) {
+            result->movement_points[i] = game.players[i].movement_points;
+        }
+        played++;
+#if MAZE_STATS
+        stats_add(&stats, &game.stats);
+#endif
+    }
+    
+    pthread_mutex_lock(&job->lock);
+    stats_add(&job->stats, &stats);
+    job->played += played;
+    pthread_mutex_unlock(&job->lock);
+    
+    if (!job->shared_board) {
+        maze_free_board(&copy);
+    }
+    return NULL;
+}
+
+// Takes the next game for worker: from its own range while that lasts,
+// then by stealing the top half of the fullest other range. -1 once every
+// range is empty.
+static int interleave_take(BatchJob* job, int worker) {
+    InterleaveQueue* own = &job->queues[worker];
+    
+    while (true) {
+        pthread_mutex_lock(&own->lock);
+        int index = own->next < own->end ? own->next : -1;
+        if (index >= 0) __atomic_store_n(&own->next, index + 1, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&own->lock);
+        if (index >= 0) return index;
+        
+        int victim = -1, most = 0;
+        for (int q = 0; q < job->num_queues; q++) {
+            int left = __atomic_load_n(&job->queues[q].end, __ATOMIC_ACQUIRE) -
+                       __atomic_load_n(&job->queues[q].next, __ATOMIC_ACQUIRE);
+            if (q != worker && left > most) {
+                victim = q;
+                most = left;
+            }
+        }
+        if (victim < 0) return -1;
+        
+        // The count above was read unlocked; it is only a hint, so the
+        // range is checked again under the victim's lock.
+        InterleaveQueue* other = &job->queues[victim];
+        pthread_mutex_lock(&other->lock);
+        int left = other->end - other->next;
+        int first = other->end - (left + 1) / 2;
+        int end = other->end;
+        if (left > 0) __atomic_store_n(&other->end, first, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&other->lock);
+        
+        if (left > 0) {
+            pthread_mutex_lock(&own->lock);
+            __atomic_store_n(&own->next, first, __ATOMIC_RELEASE);
+            __atomic_store_n(&own->end, end, __ATOMIC_RELEASE);
+            pthread_mutex_unlock(&own->lock);
+            
+            pthread_mutex_lock(&job->lock);
+            job->steals++;
+            pthread_mutex_unlock(&job->lock);
+        }
+    }
+}
+
+// Plays up to job->interleave games at once on one thread. Each GameState
+// is a stackless coroutine: maze_play_next_turn resumes it for one turn and
+// returns, so the worker round-robins over its games a turn at a time and
+// refills a slot as soon as its game ends. A game costs its GameState and
+// a result index; there is no stack to keep.
+static void interleave_worker(BatchJob* job) {
+    pthread_mutex_lock(&job->lock);
+    int worker = job->next_queue++;
+    pthread_mutex_unlock(&job->lock);
+    
+    GameState* games = malloc(job->interleave * sizeof(GameState));
+    int* game_index = malloc(job->interleave * sizeof(int));
+    if (games == NULL || game_index == NULL) {
+        fprintf(stderr, "Error: Out of memory for %d interleaved games\n", job->interleave);
+        free(games);
+        free(game_index);
+        return;
+    }
+    
+    GameStats stats;
+    memset(&stats, 0, sizeof(stats));
+    int played = 0;
+    int live = 0;
+    bool drained = false;
+    
+    while (true) {
+        while (live < job->interleave && !drained) {
+            int index = interleave_take(job, worker);
+            if (index < 0) {
+                drained = true;
+                break;
+            }
+            maze_start_game(&games[live], job->board, job->seeds[index]);
+            games[live].log_level = MAZE_LOG_OFF;
+            game_index[live++] = index;
+        }
+        if (live == 0) break;
+        
+        for (int g = 0; g < live; ) {
+            GameState* game = &games[g];
+            maze_play_next_turn(game);
+            if (!game->game_over) {
+                g++;
+                continue;
+            }
+            
+            GameResult* result = &job->results[game_index[g]];
+            result->seed = game->seed;
+            result->winner = game->winner;
+            result->round_count = game->round_count;
+            for (int i = 0; i < MAX_PLAYERS; i++) {
+                result->movement_points[i] = game->players[i].movement_points;
+            }
+            played++;
+#if MAZE_STATS
+            stats_add(&stats, &game->stats);
+#endif
+            live--;
+            games[g] = games[live];
+            game_index[g] = game_index[live];
+        }
+    }
+    
+    pthread_mutex_lock(&job->lock);
+    stats_add(&job->stats, &stats);
+    job->played += played;
+    pthread_mutex_unlock(&job->lock);
+    
+    free(games);
+    free(game_index);
+}
+
+static void print_results(const GameResult* results, int num_games) {
+    printf("seed\twinner\trounds");
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        printf("\tmp_%c", 'A' + i);
+    }
+    printf("\n");
+    
+    for (int g = 0; g < num_games; g++) {
+        const GameResult* result = &results[g];
+        printf("%u\t%c\t%d", result->seed, result->winner ? result->winner : '-', result->round_count);
+        for (int i = 0; i < MAX_PLAYERS; i++) {
+            printf("\t%d", result->movement_points[i]);
+        }
+        printf("\n");
+    }
+}
+
+static int run_batch(const Board* board, bool shared_board, int interleave, const unsigned int* seeds, int num_games, int num_threads, const char* stats_name) {
+    BatchJob job;
+    job.board = board;
+    job.shared_board = shared_board;
+    job.interleave = interleave;
+    job.seeds = seeds;
+    job.num_games = num_games;
+    job.next_game = 0;
+    job.played = 0;
+    job.queues = NULL;
+    job.num_queues = 0;
+    job.next_queue = 0;
+    job.steals = 0;
+    memset(&job.stats, 0, sizeof(job.stats));
+    job.results = malloc(num_games * sizeof(GameResult));
+    pthread_t* threads = malloc(num_threads * sizeof(pthread_t));
+    if (interleave > 0) {
+        job.queues = malloc(num_threads * sizeof(InterleaveQueue));
+    }
+    
+    if (job.results == NULL || threads == NULL || (interleave > 0 && job.queues == NULL)) {
+        fprintf(stderr, "Error: Out of memory for %d games\n", num_games);
+        free(job.results);
+        free(threads);
+        free(job.queues);
+        return 1;
+    }
+    
+    pthread_mutex_init(&job.lock, NULL);
+    
+    // Each worker starts on an even share of the seeds, in order.
+    if (interleave > 0) {
+        job.num_queues = num_threads;
+        for (int q = 0; q < num_threads; q++) {
+            job.queues[q].next = (int)((long long)num_games * q / num_threads);
+            job.queues[q].end = (int)((long long)num_games * (q + 1) / num_threads);
+            pthread_mutex_init(&job.queues[q].lock, NULL);
+        }
+    }
+    
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    int started = 0;
+    for (int t = 0; t < num_threads; t++) {
+        if (pthread_create(&threads[t], NULL, batch_worker, &job) != 0) {
+            fprintf(stderr, "Warning: Could only start %d of %d threads\n", started, num_threads);
+            break;
+        }
+        started++;
+    }
+    
+    // A worker that failed to start leaves its range to be stolen.
+    if (started == 0) {
+        batch_worker(&job);
+    }
+    
+    for (int t = 0; t < started; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    
+    // Rows of games nobody played hold nothing, so none are printed.
+    int status = 0;
+    if (job.played < num_games) {
+        fprintf(stderr, "Error: Only %d of %d games were played\n", job.played, num_games);
+        status = 1;
+    } else {
+        print_results(job.results, num_games);
+        fprintf(stderr, "Played %d games on %d threads in %.3f s (%.1f games/sec)\n",
+                num_games, started > 0 ? started : 1, elapsed, elapsed > 0 ? num_games / elapsed : 0.0);
+        if (interleave > 0) {
+            fprintf(stderr, "Interleaved up to %d games per thread at %zu bytes each; %llu ranges stolen\n",
+                    interleave, sizeof(GameState) + sizeof(int), (unsigned long long)job.steals);
+        }
+        if (stats_name != NULL) {
+            status = stats_save(&job.stats, stats_name) ? 0 : 1;
+        }
+    }
+    
+    for (int q = 0; q < job.num_queues; q++) {
+        pthread_mutex_destroy(&job.queues[q].lock);
+    }
+    pthread_mutex_destroy(&job.lock);
+    free(job.queues);
+    free(job.results);
+    free(threads);
+    return status;
+}
+
+// Times maze_apply_cell_effects over a fixed walk of floor cells. Movement
+// points are reset before every step so neither the cap nor Bawana is hit,
+// which keeps the loop on the per-step effect alone.
+int step_benchmark(long long count) {
+    Board board;
+    GameState game;
+    if (!maze_initialize_board(&board, 1, stderr)) return 1;
+    maze_start_game(&game, &board, 1);
+    game.log_level = MAZE_LOG_OFF;
+    
+    int walk[4096][3];
+    for (int i = 0; i < 4096; i++) {
+        do {
+            walk[i][0] = maze_rng_uniform(&game.rng, board.num_floors);
+            walk[i][1] = maze_rng_uniform(&game.rng, board.maze_width);
+            walk[i][2] = maze_rng_uniform(&game.rng, board.maze_length);
+        } while (!maze_is_floor_accessible(&board, walk[i][0], walk[i][1], walk[i][2]));
+    }
+    
+    Player* player = &game.players[0];
+    player->in_maze = true;
+    long long checksum = 0;
+    
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    for (long long i = 0; i < count; i++) {
+        const int* cell = walk[i & 4095];
+        int cost;
+        player->movement_points = 50 + (int)(i & 255);
+        maze_apply_cell_effects(&game, player, cell[0], cell[1], cell[2], &cost);
+        checksum += player->movement_points + cost;
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    
+    printf("Applied %lld cell effects in %.3f s (%.1f million steps/sec, checksum %lld)\n",
+           count, elapsed, elapsed > 0 ? count / elapsed / 1e6 : 0.0, checksum);
+    maze_free_board(&board);
+    return 0;
+}
+
+int batch_main(int argc, char* argv[]) {
+    bool jobs = strcmp(argv[1], "--jobs") == 0;
+    int first_option = jobs ? 3 : 4;
+    unsigned int* seeds = NULL;
+    int num_games = 0;
+    int num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    const char* board_name = NULL;
+    const char* stats_name = NULL;
+    bool shared_board = false;
+    int interleave = 0;
+    bool usage = argc < first_option;
+    
+    for (int i = first_option; i < argc && !usage; i++) {
+        if (strcmp(argv[i], "--board") == 0 && i + 1 < argc) {
+            // A compiled board's cells are played as compiled, never rolled
+            // again per seed.
+            board_name = argv[++i];
+            shared_board = true;
+        } else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+            stats_name = argv[++i];
+        } else if (strcmp(argv[i], "--interleave") == 0 && i + 1 < argc) {
+            // Interleaved games all play on the one shared board.
+            interleave = atoi(argv[++i]);
+            shared_board = true;
+            if (interleave < 1) {
+                fprintf(stderr, "Error: --interleave needs a positive game count\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--shared-board") == 0) {
+            shared_board = true;
+        } else if (i == first_option && argv[i][0] != '-') {
+            num_threads = atoi(argv[i]);
+        } else {
+            usage = true;
+        }
+    }
+    
+    if (usage) {
+        if (jobs) {
+            fprintf(stderr, "Usage: %s --jobs FILE [THREADS] [--board FILE.mzb] [--stats FILE.json] "
+                    "[--interleave GAMES] [--shared-board]\n", argv[0]);
+        } else {
+            fprintf(stderr, "Usage: %s --batch FIRST_SEED COUNT [THREADS] [--board FILE.mzb] [--stats FILE.json] "
+                    "[--interleave GAMES] [--shared-board]\n", argv[0]);
+        }
+        return 1;
+    }
+    
+    if (stats_name != NULL && !MAZE_STATS) {
+        fprintf(stderr, "Error: --stats needs a build with -DMAZE_STATS=1 or 2\n");
+        return 1;
+    }
+    
+    if (jobs) {
+        seeds = load_jobs_from_file(argv[2], &num_games);
+        if (seeds == NULL) return 1;
+    } else {
+        unsigned int first_seed = (unsigned int)strtoul(argv[2], NULL, 10);
+        num_games = atoi(argv[3]);
+        if (num_games <= 0) {
+            fprintf(stderr, "Error: Game count must be positive\n");
+            return 1;
+        }
+        
+        seeds = malloc(num_games * sizeof(unsigned int));
+        if (seeds == NULL) {
+            fprintf(stderr, "Error: Out of memory for %d games\n", num_games);
+            return 1;
+        }
+        for (int i = 0; i < num_games; i++) {
+            seeds[i] = first_seed + (unsigned int)i;
+        }
+    }
+    
+    if (num_threads < 1) num_threads = 1;
+    
+    Board board;
+    if (board_name != NULL) {
+        if (!maze_initialize_board_from_file(&board, board_name, stderr)) {
+            free(seeds);
+            return 1;
+        }
+        board.out = stderr;
+    } else {
+        // A shared text board rolls from seed.txt, as --compile-board does,
+        // so it matches the compiled board; per-seed boards roll again.
+        unsigned int seed = shared_board ? maze_load_seed_from_file("seed.txt", stderr) : 0;
+        
+        if (!maze_initialize_board(&board, seed, stderr)) {
+            free(seeds);
+            return 1;
+        }
+        board.out = stderr;
+        
+        if (!maze_load_board_files(&board, NULL)) {
+            maze_free_board(&board);
+            free(seeds);
+            return 1;
+        }
+    }
+    
+    int status = run_batch(&board, shared_board, interleave, seeds, num_games, num_threads, stats_name);
+    maze_free_board(&board);
+    free(seeds);
+    return status;
+}
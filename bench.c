@@ -0,0 +1,342 @@
+// --bench: timings of the engine's hot paths on fixed boards and seeds.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "engine_internal.h"
+#include "tools.h"
+
+#define BENCH_CELLS 4096
+#define BENCH_REPETITIONS 15
+#define BENCH_SECONDS 0.02
+#define BENCH_WALL_COUNTS 4
+
+// Everything a benchmark case touches, set up before any timing. cells
+// holds random accessible cells of board, with a direction in [3];
+// wall_boards are copies of board's floor plan carrying
+// bench_wall_counts[i] random walls.
+typedef struct {
+    Board board;
+    Board wall_boards[BENCH_WALL_COUNTS];
+    GameState game;
+    int cells[BENCH_CELLS][4];
+    int param;
+    unsigned int next_seed;
+    FILE* narration;
+    long long checksum;
+} BenchState;
+
+typedef struct {
+    const char* name;
+    void (*run)(BenchState* state, long long ops);
+    int param;
+} BenchCase;
+
+static bool bench_setup(BenchState* state);
+static void bench_free(BenchState* state);
+static double bench_run(const BenchCase* bench, BenchState* state, long long ops);
+static double bench_baseline(const char* filename, const char* name);
+
+static const int bench_wall_counts[BENCH_WALL_COUNTS] = {0, 8, 32, 128};
+
+// Puts player on the index'th benchmark cell with enough movement points
+// that no case ends up back at the start.
+static void bench_place(BenchState* state, Player* player, long long index) {
+    const int* cell = state->cells[index & (BENCH_CELLS - 1)];
+    player->floor = cell[0];
+    player->width = cell[1];
+    player->length = cell[2];
+    player->direction = (Direction)cell[3];
+    player->movement_points = 100;
+    player->in_maze = true;
+    player->triggered = false;
+    player->in_bawana = false;
+}
+
+static void bench_walls(BenchState* state, long long ops) {
+    const Board* board = &state->wall_boards[state->param];
+    for (long long i = 0; i < ops; i++) {
+        const int* cell = state->cells[i & (BENCH_CELLS - 1)];
+        int to_w = cell[1] + (cell[3] == EAST) - (cell[3] == WEST);
+        int to_l = cell[2] + (cell[3] == SOUTH) - (cell[3] == NORTH);
+        state->checksum += maze_is_path_blocked_by_wall(board, cell[0], cell[1], cell[2], to_w, to_l);
+    }
+}
+
+static void bench_stairs_poles(BenchState* state, long long ops) {
+    Player* player = &state->game.players[0];
+    for (long long i = 0; i < ops; i++) {
+        bench_place(state, player, i);
+        state->checksum += maze_check_and_use_stairs_poles(&state->game, player) + player->floor;
+    }
+}
+
+static void bench_cell_effects(BenchState* state, long long ops) {
+    Player* player = &state->game.players[0];
+    for (long long i = 0; i < ops; i++) {
+        const int* cell = state->cells[i & (BENCH_CELLS - 1)];
+        int cost;
+        player->movement_points = 50 + (int)(i & 255);
+        maze_apply_cell_effects(&state->game, player, cell[0], cell[1], cell[2], &cost);
+        state->checksum += player->movement_points + cost;
+    }
+}
+
+static void bench_move(BenchState* state, long long ops) {
+    Player* player = &state->game.players[0];
+    for (long long i = 0; i < ops; i++) {
+        bench_place(state, player, i);
+        maze_move_player_with_effects(&state->game, player, player->direction, state->param);
+        state->checksum += player->movement_points + player->width + player->length;
+        state->game.game_over = false;
+    }
+}
+
+static void bench_turn(BenchState* state, long long ops) {
+    for (long long i = 0; i < ops; i++) {
+        if (state->game.game_over) {
+            maze_start_game(&state->game, &state->board, state->next_seed++);
+            state->game.log_level = MAZE_LOG_OFF;
+        }
+        maze_play_turn(&state->game, (int)(i % MAX_PLAYERS));
+        state->checksum += state->game.players[i % MAX_PLAYERS].movement_points;
+    }
+}
+
+static void bench_game(BenchState* state, long long ops) {
+    GameState game;
+    for (long long i = 0; i < ops; i++) {
+        maze_start_game(&game, &state->board, state->next_seed++);
+        if (state->param) {
+            game.sink_context = state->narration;
+        } else {
+            game.log_level = MAZE_LOG_OFF;
+        }
+        maze_play_game(&game);
+        state->checksum += game.round_count;
+    }
+}
+
+static const BenchCase bench_cases[] = {
+    {"wall_check/0", bench_walls, 0},
+    {"wall_check/8", bench_walls, 1},
+    {"wall_check/32", bench_walls, 2},
+    {"wall_check/128", bench_walls, 3},
+    {"stairs_poles", bench_stairs_poles, 0},
+    {"cell_effects", bench_cell_effects, 0},
+    {"move/1", bench_move, 1},
+    {"move/2", bench_move, 2},
+    {"move/3", bench_move, 3},
+    {"move/4", bench_move, 4},
+    {"move/6", bench_move, 6},
+    {"move/8", bench_move, 8},
+    {"move/12", bench_move, 12},
+    {"play_turn", bench_turn, 0},
+    {"game/silent", bench_game, 0},
+    {"game/narrated", bench_game, 1},
+};
+
+// Loads the text-file board and builds the wall boards and cell list from
+// fixed seeds, so every run and every engine revision times the same work.
+static bool bench_setup(BenchState* state) {
+    if (!maze_initialize_board(&state->board, 1, stderr)) return false;
+    state->board.out = NULL;
+    if (!maze_load_board_files(&state->board, NULL)) {
+        maze_free_board(&state->board);
+        return false;
+    }
+    
+    GeneratorConfig config;
+    if (!generator_setup(&config, &state->board, 0, 0, 0)) {
+        maze_free_board(&state->board);
+        return false;
+    }
+    
+    int built = 0;
+    bool ok = true;
+    for (; built < BENCH_WALL_COUNTS && ok; built++) {
+        config.num_walls = bench_wall_counts[built];
+        int rejected;
+        if (!generator_board(&state->wall_boards[built], &state->board, &config)) break;
+        ok = generate_board(&state->wall_boards[built], 1, &config, &rejected);
+    }
+    ok = ok && built == BENCH_WALL_COUNTS;
+    free(config.open_cells);
+    
+    if (!ok) {
+        fprintf(stderr, "Error: Cannot build the wall benchmark boards\n");
+        for (int i = 0; i < built; i++) {
+            maze_free_board(&state->wall_boards[i]);
+        }
+        maze_free_board(&state->board);
+        return false;
+    }
+    
+    maze_start_game(&state->game, &state->board, 1);
+    state->game.log_level = MAZE_LOG_OFF;
+    
+    for (int i = 0; i < BENCH_CELLS; i++) {
+        int* cell = state->cells[i];
+        do {
+            cell[0] = maze_rng_uniform(&state->game.rng, state->board.num_floors);
+            cell[1] = maze_rng_uniform(&state->game.rng, state->board.maze_width);
+            cell[2] = maze_rng_uniform(&state->game.rng, state->board.maze_length);
+        } while (!maze_is_floor_accessible(&state->board, cell[0], cell[1], cell[2]));
+        cell[3] = NORTH + maze_rng_uniform(&state->game.rng, 4);
+    }
+    
+    state->next_seed = 1;
+    state->checksum = 0;
+    state->narration = fopen("/dev/null", "w");
+    if (state->narration == NULL) {
+        fprintf(stderr, "Error: Cannot open /dev/null for narration\n");
+        bench_free(state);
+        return false;
+    }
+    return true;
+}
+
+static void bench_free(BenchState* state) {
+    if (state->narration != NULL) fclose(state->narration);
+    for (int i = 0; i < BENCH_WALL_COUNTS; i++) {
+        maze_free_board(&state->wall_boards[i]);
+    }
+    maze_free_board(&state->board);
+}
+
+// Times ops calls of bench and returns the nanoseconds per call.
+static double bench_run(const BenchCase* bench, BenchState* state, long long ops) {
+    struct timespec start, end;
+    state->param = bench->param;
+    
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    bench->run(state, ops);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    return elapsed * 1e9 / ops;
+}
+
+// Finds the median for case name in a JSON file written by --bench, which
+// puts each case on a line of its own. Returns a negative value if the
+// file or the case is missing.
+static double bench_baseline(const char* filename, const char* name) {
+    FILE* file = fopen(filename, "r");
+    if (file == NULL) return -1;
+    
+    char line[512];
+    char key[128];
+    double median = -1;
+    snprintf(key, sizeof(key), "\"name\": \"%s\",", name);
+    
+    while (fgets(line, sizeof(line), file) != NULL) {
+        const char* field = strstr(line, "\"p50_ns\": ");
+        if (strstr(line, key) != NULL && field != NULL) {
+            median = strtod(field + strlen("\"p50_ns\": "), NULL);
+            break;
+        }
+    }
+    
+    fclose(file);
+    return median;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+int bench_main(int argc, char* argv[]) {
+    int repetitions = BENCH_REPETITIONS;
+    const char* filter = NULL;
+    const char* baseline = NULL;
+    
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+            repetitions = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baseline = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s --bench [--reps N] [--filter PREFIX] [--baseline FILE.json]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (repetitions < 1) repetitions = 1;
+    
+    BenchState* state = malloc(sizeof(BenchState));
+    double* samples = malloc(repetitions * sizeof(double));
+    if (state == NULL || samples == NULL || !bench_setup(state)) {
+        fprintf(stderr, "Error: Cannot set up the benchmarks\n");
+        free(state);
+        free(samples);
+        return 1;
+    }
+    
+    printf("{\"benchmark\": \"maze_game\", \"repetitions\": %d, \"log_level\": %d, \"cases\": [\n",
+           repetitions, MAZE_LOG_LEVEL);
+    bool first = true;
+    
+    for (size_t c = 0; c < sizeof(bench_cases) / sizeof(bench_cases[0]); c++) {
+        const BenchCase* bench = &bench_cases[c];
+        if (filter != NULL && strncmp(bench->name, filter, strlen(filter)) != 0) continue;
+        
+        // Doubling the batch until it fills a repetition also warms the
+        // caches and branch predictors before any sample is kept.
+        long long ops = 1;
+        double per_op = bench_run(bench, state, ops);
+        while (per_op * ops < BENCH_SECONDS * 1e9 / 2) {
+            ops *= 2;
+            per_op = bench_run(bench, state, ops);
+        }
+        
+        double sum = 0;
+        for (int r = 0; r < repetitions; r++) {
+            samples[r] = bench_run(bench, state, ops);
+            sum += samples[r];
+        }
+        qsort(samples, repetitions, sizeof(double), compare_doubles);
+        
+        double median = samples[repetitions / 2];
+        double p90 = samples[(repetitions * 9) / 10];
+        double min = samples[0], max = samples[repetitions - 1];
+        
+        // The median absolute deviation, unlike a standard deviation, is
+        // not dragged around by the odd repetition a context switch hit.
+        for (int r = 0; r < repetitions; r++) {
+            samples[r] = samples[r] > median ? samples[r] - median : median - samples[r];
+        }
+        qsort(samples, repetitions, sizeof(double), compare_doubles);
+        
+        printf("%s  {\"name\": \"%s\", \"ops\": %lld, \"min_ns\": %.3f, \"p50_ns\": %.3f, \"p90_ns\": %.3f, "
+               "\"max_ns\": %.3f, \"mean_ns\": %.3f, \"mad_ns\": %.3f, \"per_sec\": %.1f}",
+               first ? "" : ",\n", bench->name, ops, min, median, p90, max,
+               sum / repetitions, samples[repetitions / 2], median > 0 ? 1e9 / median : 0.0);
+        fflush(stdout);
+        first = false;
+        
+        if (baseline != NULL) {
+            double before = bench_baseline(baseline, bench->name);
+            if (before > 0) {
+                fprintf(stderr, "%-16s %12.1f ns -> %12.1f ns  (%+.1f%%)\n",
+                        bench->name, before, median, (median / before - 1) * 100);
+            } else {
+                fprintf(stderr, "%-16s %12s    -> %12.1f ns  (new)\n", bench->name, "-", median);
+            }
+        }
+    }
+    
+    printf("\n], \"checksum\": %lld}\n", state->checksum);
+    
+    bench_free(state);
+    free(state);
+    free(samples);
+    return 0;
+}
@@ -0,0 +1,2996 @@
+// The game engine behind libmaze and the maze_game tools: boards, their
+// text loaders and compiled images, and play. libmaze.so exports only the
+// functions in maze_game.h.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "engine_internal.h"
+
+#if MAZE_STATS
+#define STAT_ADD(game, counter, n) ((game)->stats.counter += (n))
+#else
+#define STAT_ADD(game, counter, n) ((void)0)
+#endif
+
+#if MAZE_STATS >= 2
+#define STAT_TIME(game, timer, call) do { \
+        uint64_t stat_start = stats_clock(); \
+        call; \
+        (game)->stats.timer##_time += stats_clock() - stat_start; \
+        (game)->stats.timer##_timed++; \
+    } while (0)
+#else
+#define STAT_TIME(game, timer, call) call
+#endif
+
+// What stepping onto a cell does to a player's movement points p:
+// p' = (p <= 100 ? p * multiplier : p + large_bonus) - cost + bonus.
+// Only multiplier cells have a multiplier other than 1 or a large_bonus.
+typedef struct {
+    int8_t cost;
+    int8_t bonus;
+    int8_t multiplier;
+    int8_t large_bonus;
+} CellEffect;
+
+static const CellEffect cell_effects[NUM_CELL_EFFECTS] = {
+    // consumable 0-4, bonus add 1-5, multiply by 2 or 3
+    {0, 0, 1, 0},
+    {1, 0, 1, 0},
+    {2, 0, 1, 0},
+    {3, 0, 1, 0},
+    {4, 0, 1, 0},
+    {0, 1, 1, 0},
+    {0, 2, 1, 0},
+    {0, 3, 1, 0},
+    {0, 4, 1, 0},
+    {0, 5, 1, 0},
+    {0, 0, 2, 40},
+    {0, 0, 3, 60}
+};
+
+// Home cell and facing of each player, and the cell it enters the maze on.
+// Bawana effects that send a player back out leave it on the Bawana exit.
+// The Bawana covers floor 0 from [6, 20] to [9, 24]. Every board must open
+// all of these cells on floor 0; see has_fixed_areas.
+const int maze_player_home[MAX_PLAYERS][3] = {{6, 12, NORTH}, {9, 8, WEST}, {9, 16, EAST}};
+const int maze_player_entry[MAX_PLAYERS][2] = {{5, 12}, {9, 7}, {9, 17}};
+const int maze_bawana_exit[2] = {9, 19};
+static const int bawana_area[4] = {6, 20, 9, 24};
+
+// A game's play state as plain data: no pointers, so it can be stored,
+// copied between threads or written out as is. It is only meaningful on
+// the board it was taken from; board_shape is kept as a check.
+typedef struct {
+    int32_t movement_points;
+    int32_t dice_throw_count;
+    int8_t floor, width, length, direction;
+    int8_t food_poisoning_turns, disoriented_turns;
+    uint8_t flags;
+    char name;
+} PlayerSnapshot;
+
+typedef struct {
+    uint32_t seed;
+    int32_t round_count;
+    uint8_t game_over;
+    char winner;
+    uint8_t next_player;
+    uint64_t board_shape;
+    uint32_t rng_key[2];
+    uint64_t rng_stream;
+    uint64_t rng_position;
+    PlayerSnapshot players[MAX_PLAYERS];
+    uint64_t stairs_up[MAX_STAIRS / 64];
+} GameSnapshot;
+
+#define BOARD_FILE_MAGIC "MZBD"
+#define BOARD_FILE_VERSION 6
+#define BOARD_BYTE_ORDER 0x01020304u
+
+typedef struct {
+    uint32_t offset;
+    uint32_t size;
+} BoardSection;
+
+// A compiled board (.mzb): this header, then the board's arena laid out
+// compactly from arena_offset. sections[] gives each BOARD_ARRAYS entry's
+// offset and size inside the arena, so loading maps the file and points
+// the Board at it. The checksum is FNV-1a over every byte after the header.
+// The cells are the ones rolled for seed, so the file replays exactly like
+// the text boards.
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t header_size;
+    uint64_t checksum;
+    uint32_t file_size;
+    uint32_t seed;
+    int32_t floors, width, length;
+    int32_t num_stairs, num_poles, num_walls;
+    int32_t flag_floor, flag_width, flag_length;
+    uint32_t arena_offset;
+    uint32_t arena_size;
+    Rules rules;
+    BoardSection sections[BOARD_ARRAY_COUNT];
+} BoardFileHeader;
+
+// Cursor over a memory-mapped configuration file. Records are runs of
+// comma-separated integers; a record may not span lines, but several may
+// share one line. Nothing is copied out of the mapping.
+typedef struct {
+    const char* filename;
+    const char* data;
+    size_t size;
+    size_t pos;
+    size_t line_start;
+    int line;
+    int record_line;
+    int record_column;
+    FILE* out;
+} ConfigReader;
+
+static void game_snapshot(const GameState* game, GameSnapshot* snapshot);
+static bool game_restore(GameState* game, const GameSnapshot* snapshot);
+static uint64_t board_shape(const Board* board);
+static bool snapshot_fits(const GameSnapshot* snapshot, const GameState* game);
+static void game_fork(GameState* child, const GameState* parent, uint64_t branch);
+static uint64_t fork_stream(const Rng* rng, uint64_t branch);
+static void board_offsets(const Board* board, size_t offsets[]);
+static void board_sizes(const Board* board, size_t sizes[]);
+static void board_point_into(Board* board, uint8_t* base, const size_t offsets[]);
+static void release_arena(Arena* arena);
+static bool set_board_dimensions(Board* board, int floors, int width, int length);
+static void add_floor_area(Board* board, int floor, int start_width, int start_length, int end_width, int end_length);
+static bool use_classic_floor_plan(Board* board);
+static bool has_fixed_areas(const Board* board);
+static void initialize_players(GameState* game);
+static void initialize_maze_cells(Board* board, Rng* rng);
+static void initialize_bawana_area(Board* board, Rng* rng);
+static bool load_stairs_from_file(Board* board, const char* filename);
+static bool load_poles_from_file(Board* board, const char* filename);
+static bool load_walls_from_file(Board* board, const char* filename);
+static void load_flag_from_file(Board* board, const char* filename);
+static bool config_open(ConfigReader* reader, const char* filename, FILE* out);
+static void config_close(ConfigReader* reader);
+static void config_report(ConfigReader* reader, const char* kind, int line, int column, const char* format, va_list args);
+static void config_error(ConfigReader* reader, int line, int column, const char* format, ...);
+static void config_warning(ConfigReader* reader, int line, int column, const char* format, ...);
+static int config_next_record(ConfigReader* reader, int* values, int count);
+static void config_rewind(ConfigReader* reader, FILE* out);
+static uint64_t board_checksum(const uint8_t* data, size_t size);
+static bool initialize_board_from_memory(Board* board, const void* data, size_t size, const char* name, FILE* errors);
+static Rng rng_split(const Rng* rng, uint64_t stream);
+static uint32_t rng_next(Rng* rng);
+static int board_printf(const Board* board, const char* format, ...);
+static void board_error(const Board* board, const char* format, ...);
+static MazeEvent make_event(MazeEventType type, const Player* player);
+static void emit_event(GameState* game, const MazeEvent* event);
+static void render_event(FILE* out, const MazeEvent* event);
+static void text_event_sink(void* context, const MazeEvent* event);
+static int roll_movement_dice(GameState* game);
+static Direction roll_direction_dice(GameState* game);
+static Direction get_random_direction(GameState* game);
+static bool is_valid_position(const Board* board, int floor, int width, int length);
+static bool can_move_single_step(const Board* board, int floor, int from_w, int from_l, int to_w, int to_l);
+static int next_cell(const Board* board, int floor, int width, int length, Direction dir);
+static int cell_transition(const GameState* game, int cell);
+static bool is_event_cell(const Board* board, int cell);
+static void build_ray_tables(Board* board);
+static bool flag_reachable(const Board* board);
+static void apply_bawana_effect(GameState* game, Player* player);
+static void capture_player(GameState* game, int capturer_index, int captured_index);
+static void transport_to_bawana(GameState* game, Player* player);
+static void print_game_state(GameState* game, int level);
+static void print_player_status(GameState* game, Player* player);
+static const char* direction_to_string(Direction dir);
+static const char* get_cell_type_name(BawanaEffect effect);
+static int game_uniform(GameState* game, uint32_t bound);
+static int script_draw(DrawScript* script, uint32_t bound);
+#if MAZE_STATS >= 2
+static uint64_t stats_clock(void);
+#endif
+static uint32_t game_hash(const GameState* game);
+static int tape_draw(GameState* game, uint32_t bound);
+static void tape_turn(GameState* game);
+
+static void check_and_cap_movement_points(GameState* game, Player* player) {
+    if (player->movement_points > game->board->rules.max_points) {
+        player->movement_points = game->board->rules.max_points;
+        STAT_ADD(game, mp_cap_hits, 1);
+    }
+    
+    if (player->movement_points <= 0) {
+        transport_to_bawana(game, player);
+    }
+}
+
+unsigned int maze_load_seed_from_file(const char* filename, FILE* out) {
+    ConfigReader reader;
+    if (!config_open(&reader, filename, out)) {
+        fprintf(out, "Warning: Cannot open %s, using time-based seed\n", filename);
+        return (unsigned int)time(NULL);
+    }
+    
+    int seed;
+    unsigned int result;
+    if (config_next_record(&reader, &seed, 1) == 1) {
+        result = (unsigned int)seed;
+        fprintf(out, "Random seed loaded: %d\n", seed);
+    } else {
+        fprintf(out, "Warning: Invalid seed file, using time-based seed\n");
+        result = (unsigned int)time(NULL);
+    }
+    
+    config_close(&reader);
+    return result;
+}
+
+void maze_rng_seed(Rng* rng, uint64_t seed, uint64_t stream) {
+    rng->key[0] = (uint32_t)seed;
+    rng->key[1] = (uint32_t)(seed >> 32);
+    rng->stream = stream;
+    rng->position = 0;
+    rng->cached_block = UINT64_MAX;
+}
+
+static Rng rng_split(const Rng* rng, uint64_t stream) {
+    Rng child = *rng;
+    child.stream = stream;
+    child.position = 0;
+    child.cached_block = UINT64_MAX;
+    return child;
+}
+
+// Skips draws 32-bit outputs in O(1), leaving rng where that many calls to
+// rng_next would. maze_rng_uniform takes one output per draw when bound is
+// a power of two and may take more otherwise.
+void maze_rng_jump(Rng* rng, uint64_t draws) {
+    rng->position += draws;
+}
+
+static uint32_t mulhilo32(uint32_t a, uint32_t b, uint32_t* hi) {
+    uint64_t product = (uint64_t)a * b;
+    *hi = (uint32_t)(product >> 32);
+    return (uint32_t)product;
+}
+
+static uint32_t rng_next(Rng* rng) {
+    uint64_t block_index = rng->position >> 2;
+    
+    if (block_index != rng->cached_block) {
+        uint32_t c0 = (uint32_t)block_index, c1 = (uint32_t)(block_index >> 32);
+        uint32_t c2 = (uint32_t)rng->stream, c3 = (uint32_t)(rng->stream >> 32);
+        uint32_t k0 = rng->key[0], k1 = rng->key[1];
+        
+        for (int round = 0; round < 10; round++) {
+            uint32_t hi0, hi1;
+            uint32_t lo0 = mulhilo32(0xD2511F53u, c0, &hi0);
+            uint32_t lo1 = mulhilo32(0xCD9E8D57u, c2, &hi1);
+            c0 = hi1 ^ c1 ^ k0;
+            c1 = lo1;
+            c2 = hi0 ^ c3 ^ k1;
+            c3 = lo0;
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+        
+        rng->block[0] = c0;
+        rng->block[1] = c1;
+        rng->block[2] = c2;
+        rng->block[3] = c3;
+        rng->cached_block = block_index;
+    }
+    
+    return rng->block[rng->position++ & 3];
+}
+
+// Rejection sampling keeps every face equally likely, unlike a bare modulo.
+int maze_rng_uniform(Rng* rng, uint32_t bound) {
+    uint32_t threshold = (0u - bound) % bound;
+    uint32_t r;
+    do {
+        r = rng_next(rng);
+    } while (r < threshold);
+    return (int)(r % bound);
+}
+
+// Every draw a game makes comes through here. With a script attached the
+// Markov solver picks the outcomes instead of the dice stream.
+static int game_uniform(GameState* game, uint32_t bound) {
+    if (game->script != NULL) {
+        return script_draw(game->script, bound);
+    }
+    if (game->tape != NULL) {
+        return tape_draw(game, bound);
+    }
+    return maze_rng_uniform(&game->rng, bound);
+}
+
+static int board_printf(const Board* board, const char* format, ...) {
+    if (board->out == NULL) return 0;
+    
+    va_list args;
+    va_start(args, format);
+    int written = vfprintf(board->out, format, args);
+    va_end(args);
+    return written;
+}
+
+static void board_error(const Board* board, const char* format, ...) {
+    if (board->errors == NULL) return;
+    
+    va_list args;
+    va_start(args, format);
+    vfprintf(board->errors, format, args);
+    va_end(args);
+}
+
+static MazeEvent make_event(MazeEventType type, const Player* player) {
+    MazeEvent event;
+    memset(&event, 0, sizeof(event));
+    event.type = (uint8_t)type;
+    
+    if (player != NULL) {
+        event.player = player->name;
+        event.direction = (int8_t)player->direction;
+        event.floor = (int8_t)player->floor;
+        event.width = (int8_t)player->width;
+        event.length = (int8_t)player->length;
+    }
+    return event;
+}
+
+static void emit_event(GameState* game, const MazeEvent* event) {
+    if (game->sink != NULL) {
+        game->sink(game->sink_context, event);
+    }
+}
+
+static void render_event(FILE* out, const MazeEvent* e) {
+    switch(e->type) {
+        case MAZE_EVENT_TURN_START:
+            fprintf(out, "\n--- Player %c's Turn (Round %d) ---\n", e->player, e->value);
+            break;
+            
+        case MAZE_EVENT_STAIR_FLIP:
+            fprintf(out, "--- Stair directions changed at round %d ---\n", e->value);
+            break;
+            
+        case MAZE_EVENT_STATE_BEGIN:
+            fprintf(out, "\n=== ROUND %d GAME STATE ===\n", e->value);
+            break;
+            
+        case MAZE_EVENT_PLAYER_STATUS:
+            fprintf(out, "Player %c: ", e->player);
+            if (!(e->count & MAZE_STATUS_IN_MAZE)) {
+                fprintf(out, "Starting area [%d, %d, %d]", e->floor, e->width, e->length);
+            } else {
+                fprintf(out, "[%d, %d, %d] facing %s", e->floor, e->width, e->length, 
+                        direction_to_string((Direction)e->direction));
+            }
+            fprintf(out, " - MP: %d", e->amount);
+            if (e->to_floor > 0) {
+                fprintf(out, " [POISONED: %d turns]", e->to_floor);
+            }
+            if (e->to_width > 0) {
+                fprintf(out, " [DISORIENTED: %d turns]", e->to_width);
+            }
+            if (e->count & MAZE_STATUS_TRIGGERED) {
+                fprintf(out, " [TRIGGERED: 2x speed]");
+            }
+            if (e->count & MAZE_STATUS_IN_BAWANA) {
+                fprintf(out, " [IN BAWANA]");
+            }
+            fprintf(out, " (throws: %d)\n", e->value);
+            break;
+            
+        case MAZE_EVENT_STATE_END:
+            fprintf(out, "Flag: [%d, %d, %d]\n", e->floor, e->width, e->length);
+            fprintf(out, "==========================\n\n");
+            break;
+            
+        case MAZE_EVENT_GAME_WON:
+            fprintf(out, "\nCONGRATULATIONS PLAYER %c! YOU WON THE GAME!\n", e->player);
+            break;
+            
+        case MAZE_EVENT_FLAG_CAPTURE:
+            fprintf(out, "\nGAME OVER! Player %c captured the flag at [%d, %d, %d]!\n", 
+                    e->player, e->floor, e->width, e->length);
+            break;
+            
+        case MAZE_EVENT_ENTRY_ROLL:
+            if (e->amount == 6) {
+                fprintf(out, "%c is at the starting area and rolls 6 on the movement dice and is placed on [%d, %d, %d] of the maze.\n", 
+                        e->player, e->floor, e->width, e->length);
+            } else {
+                fprintf(out, "%c is at the starting area and rolls %d on the movement dice cannot enter the maze.\n", 
+                        e->player, e->amount);
+            }
+            break;
+            
+        case MAZE_EVENT_MOVE_ROLL:
+            fprintf(out, "%c rolls and %d on the movement dice and moves %s by %d cells and is now at ", 
+                    e->player, e->amount, direction_to_string((Direction)e->direction), e->amount);
+            break;
+            
+        case MAZE_EVENT_DIRECTION_ROLL:
+            if (e->count != EMPTY) {
+                fprintf(out, "%c rolls and %d on the movement dice and %s on the direction dice, changes direction to %s and moves %d cells and is now at ", 
+                        e->player, e->amount, direction_to_string((Direction)e->count), 
+                        direction_to_string((Direction)e->direction), e->amount);
+            } else {
+                fprintf(out, "%c rolls and %d on the movement dice and Empty on the direction dice, changes direction to %s and moves %d cells and is now at ", 
+                        e->player, e->amount, direction_to_string((Direction)e->direction), e->amount);
+            }
+            break;
+            
+        case MAZE_EVENT_TRIGGERED_ROLL:
+            fprintf(out, "%c is triggered and rolls and %d on the movement dice and move in the %s and moves %d cells and is placed at the ", 
+                    e->player, e->amount, direction_to_string((Direction)e->direction), e->amount * 2);
+            break;
+            
+        case MAZE_EVENT_DISORIENTED_ROLL:
+            fprintf(out, "%c rolls and %d on the movement dice and is disoriented and move in the %s and moves %d cells and is placed at the ", 
+                    e->player, e->amount, direction_to_string((Direction)e->direction), e->amount);
+            break;
+            
+        case MAZE_EVENT_DISORIENT_RECOVERED:
+            fprintf(out, "%c has recovered from disorientation.\n", e->player);
+            break;
+            
+        case MAZE_EVENT_BLOCKED:
+            fprintf(out, "%c rolls and %d on the movement dice and cannot move in the %s. Player remains at [%d, %d, %d]\n", 
+                    e->player, e->amount, direction_to_string((Direction)e->direction), 
+                    e->floor, e->width, e->length);
+            break;
+            
+        case MAZE_EVENT_MOVE_SUMMARY:
+            fprintf(out, "%c moved %d cells that cost %d movement points and is left with %d and is moving in the %s.\n", 
+                    e->player, e->count, e->amount, e->value, direction_to_string((Direction)e->direction));
+            break;
+            
+        case MAZE_EVENT_POSITION:
+            fprintf(out, "[%d, %d, %d].\n", e->floor, e->width, e->length);
+            break;
+            
+        case MAZE_EVENT_STAIR:
+            fprintf(out, "%c lands on [%d, %d, %d] which is a stair cell.\n", 
+                    e->player, e->floor, e->width, e->length);
+            fprintf(out, "%c takes the stairs and now placed at [%d, %d, %d] in floor %d.\n", 
+                    e->player, e->to_width, e->to_length, e->to_floor, e->to_floor);
+            break;
+            
+        case MAZE_EVENT_POLE:
+            fprintf(out, "%c lands on [%d, %d, %d] which is a pole cell.\n", 
+                    e->player, e->floor, e->width, e->length);
+            fprintf(out, "%c slides down and now placed at [%d, %d, %d] in floor %d.\n", 
+                    e->player, e->to_width, e->to_length, e->to_floor, e->to_floor);
+            break;
+            
+        case MAZE_EVENT_BAWANA_TRANSPORT:
+            fprintf(out, "%c movement points are depleted and requires replenishment. Transporting to Bawana.\n", e->player);
+            break;
+            
+        case MAZE_EVENT_BAWANA_EFFECT:
+            fprintf(out, "%c is place on a %s and effects take place.\n", e->player, get_cell_type_name((BawanaEffect)e->count));
+            switch(e->count) {
+                case BAWANA_FOOD_POISONING:
+                    fprintf(out, "%c eats from Bawana and have a bad case of food poisoning. Will need three rounds to recover.\n", e->player);
+                    break;
+                case BAWANA_DISORIENTED:
+                    fprintf(out, "%c eats from Bawana and is disoriented and is placed at the entrance of Bawana with 50 movement points.\n", e->player);
+                    break;
+                case BAWANA_TRIGGERED:
+                    fprintf(out, "%c eats from Bawana and is triggered due to bad quality of food. %c is placed at the entrance of Bawana with 50 movement points.\n", e->player, e->player);
+                    break;
+                case BAWANA_HAPPY:
+                    fprintf(out, "%c eats from Bawana and is happy. %c is placed at the entrance of Bawana with 200 movement points.\n", e->player, e->player);
+                    break;
+                default:
+                    fprintf(out, "%c eats from Bawana and earns %d movement points and is placed at the [%d, %d, %d].\n", 
+                            e->player, e->amount, e->floor, e->width, e->length);
+                    break;
+            }
+            break;
+            
+        case MAZE_EVENT_POISON_SKIP:
+            fprintf(out, "%c is still food poisoned and misses the turn.\n", e->player);
+            break;
+            
+        case MAZE_EVENT_POISON_RECOVERED:
+            fprintf(out, "%c is now fit to proceed from the food poisoning episode and now placed on a ", e->player);
+            break;
+            
+        default:
+            break;
+    }
+}
+
+static void text_event_sink(void* context, const MazeEvent* event) {
+    render_event((FILE*)context, event);
+}
+
+static bool config_open(ConfigReader* reader, const char* filename, FILE* out) {
+    reader->filename = filename;
+    reader->data = NULL;
+    reader->size = 0;
+    reader->pos = 0;
+    reader->line_start = 0;
+    reader->line = 1;
+    reader->record_line = 1;
+    reader->record_column = 1;
+    reader->out = out;
+    
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return false;
+    
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return false;
+    }
+    
+    // An empty file cannot be mapped; it simply has no records.
+    if (info.st_size > 0) {
+        void* data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        reader->data = (const char*)data;
+        reader->size = (size_t)info.st_size;
+    }
+    
+    close(fd);
+    return true;
+}
+
+static void config_close(ConfigReader* reader) {
+    if (reader->data != NULL) {
+        munmap((void*)reader->data, reader->size);
+        reader->data = NULL;
+    }
+}
+
+static void config_report(ConfigReader* reader, const char* kind, int line, int column, const char* format, va_list args) {
+    if (reader->out == NULL) return;
+    
+    fprintf(reader->out, "%s: %s:%d:%d: ", kind, reader->filename, line, column);
+    vfprintf(reader->out, format, args);
+    fputc('\n', reader->out);
+}
+
+// Errors stop the file, or the whole load; warnings skip one record.
+static void config_error(ConfigReader* reader, int line, int column, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    config_report(reader, "Error", line, column, format, args);
+    va_end(args);
+}
+
+static void config_warning(ConfigReader* reader, int line, int column, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    config_report(reader, "Warning", line, column, format, args);
+    va_end(args);
+}
+
+// Reads the next record of count integers. Returns 1 on success, 0 at the
+// end of the file and -1 after reporting a syntax error.
+static int config_next_record(ConfigReader* reader, int* values, int count) {
+    const char* data = reader->data;
+    size_t size = reader->size;
+    size_t pos = reader->pos;
+    
+    // Between records: any whitespace, plus one optional comma.
+    bool comma_seen = false;
+    while (pos < size) {
+        char c = data[pos];
+        if (c == '\n') {
+            reader->line++;
+            reader->line_start = pos + 1;
+        } else if (c == ',' && !comma_seen) {
+            comma_seen = true;
+        } else if (c != ' ' && c != '\t' && c != '\r') {
+            break;
+        }
+        pos++;
+    }
+    
+    reader->pos = pos;
+    reader->record_line = reader->line;
+    reader->record_column = (int)(pos - reader->line_start) + 1;
+    if (pos == size) return 0;
+    
+    for (int i = 0; i < count; i++) {
+        if (i > 0) {
+            while (pos < size && (data[pos] == ' ' || data[pos] == '\t' || data[pos] == '\r')) pos++;
+            if (pos == size || data[pos] != ',') {
+                config_error(reader, reader->line, (int)(pos - reader->line_start) + 1,
+                             "expected %d values per record, found %d", count, i);
+                return -1;
+            }
+            pos++;
+            while (pos < size && (data[pos] == ' ' || data[pos] == '\t' || data[pos] == '\r')) pos++;
+        }
+        
+        int column = (int)(pos - reader->line_start) + 1;
+        bool negative = false;
+        if (pos < size && (data[pos] == '-' || data[pos] == '+')) {
+            negative = data[pos] == '-';
+            pos++;
+        }
+        
+        if (pos == size || data[pos] < '0' || data[pos] > '9') {
+            config_error(reader, reader->line, column, "expected an integer");
+            return -1;
+        }
+        
+        long long value = 0;
+        while (pos < size && data[pos] >= '0' && data[pos] <= '9') {
+            value = value * 10 + (data[pos] - '0');
+            if (value > (long long)INT_MAX + 1) {
+                config_error(reader, reader->line, column, "integer out of range");
+                return -1;
+            }
+            pos++;
+        }
+        
+        if (negative) value = -value;
+        if (value > INT_MAX) {
+            config_error(reader, reader->line, column, "integer out of range");
+            return -1;
+        }
+        values[i] = (int)value;
+    }
+    
+    // A record must be followed by a separator, not glued to other text.
+    if (pos < size && data[pos] != ',' && data[pos] != ' ' && data[pos] != '\t' &&
+        data[pos] != '\r' && data[pos] != '\n') {
+        config_error(reader, reader->line, (int)(pos - reader->line_start) + 1,
+                     "unexpected character '%c'", data[pos]);
+        return -1;
+    }
+    
+    reader->pos = pos;
+    return 1;
+}
+
+static void config_rewind(ConfigReader* reader, FILE* out) {
+    reader->pos = 0;
+    reader->line_start = 0;
+    reader->line = 1;
+    reader->out = out;
+}
+
+// Floor plan records: floor, first width, first length, last width, last
+// length, after a first record giving floors, width and length. Returns
+// false, leaving the board unusable, if the file cannot be read or its plan
+// misses a cell the players or the Bawana need.
+bool maze_load_floor_plan_from_file(Board* board, const char* filename) {
+    ConfigReader reader;
+    if (!config_open(&reader, filename, board->out)) {
+        board_error(board, "Error: Cannot open %s\n", filename);
+        return false;
+    }
+    
+    // Errors that stop the load go to errors even when out is silenced.
+    int size[3];
+    if (config_next_record(&reader, size, 3) != 1) {
+        board_error(board, "Error: Invalid board file format in %s\n", filename);
+        config_close(&reader);
+        return false;
+    }
+    if (size[0] < 1 || size[0] > MAX_DIMENSION || size[1] < 1 || size[1] > MAX_DIMENSION ||
+        size[2] < 1 || size[2] > MAX_DIMENSION) {
+        reader.out = board->errors;
+        config_error(&reader, reader.record_line, reader.record_column,
+                     "board dimensions must be between 1 and %d", MAX_DIMENSION);
+        config_close(&reader);
+        return false;
+    }
+    
+    if (!set_board_dimensions(board, size[0], size[1], size[2])) {
+        config_close(&reader);
+        return false;
+    }
+    int v[5];
+    
+    while (config_next_record(&reader, v, 5) == 1) {
+        if (!is_valid_position(board, v[0], v[1], v[2]) || !is_valid_position(board, v[0], v[3], v[4])) {
+            config_warning(&reader, reader.record_line, reader.record_column,
+                           "area on floor %d from [%d, %d] to [%d, %d] leaves the board",
+                           v[0], v[1], v[2], v[3], v[4]);
+            continue;
+        }
+        add_floor_area(board, v[0], v[1], v[2], v[3], v[4]);
+    }
+    
+    // Homes, entries and the Bawana sit at fixed places on floor 0.
+    if (!has_fixed_areas(board)) {
+        reader.out = board->errors;
+        config_error(&reader, 1, 1, "floor 0 must cover the homes, entries, Bawana and its exit");
+        config_close(&reader);
+        return false;
+    }
+    
+    maze_build_adjacency_table(board);
+    maze_build_transition_index(board);
+    maze_roll_board(board, board->seed);
+    
+    board_printf(board, "Loaded %d floors of %d x %d from %s\n",
+                board->num_floors, board->maze_width, board->maze_length, filename);
+    config_close(&reader);
+    return true;
+}
+
+static bool load_stairs_from_file(Board* board, const char* filename) {
+    ConfigReader reader;
+    if (!config_open(&reader, filename, board->out)) {
+        board_printf(board, "Warning: Cannot open %s\n", filename);
+        return true;
+    }
+    
+    int v[6];
+    int count = 0;
+    reader.out = NULL;
+    while (config_next_record(&reader, v, 6) == 1) count++;
+    config_rewind(&reader, board->out);
+    if (count > MAX_STAIRS) count = MAX_STAIRS;
+    
+    board->num_stairs = 0;
+    board->stairs = maze_board_alloc(board, count * sizeof(Stair));
+    board->stair_end_next = maze_board_alloc(board, count * 2 * sizeof(int32_t));
+    if (board->stairs == NULL || board->stair_end_next == NULL) {
+        config_close(&reader);
+        return false;
+    }
+    
+    while (config_next_record(&reader, v, 6) == 1) {
+        if (!maze_is_floor_accessible(board, v[0], v[1], v[2]) || !maze_is_floor_accessible(board, v[3], v[4], v[5])) {
+            config_warning(&reader, reader.record_line, reader.record_column,
+                           "stair [%d, %d, %d] -> [%d, %d, %d] has an end off the floor plan",
+                           v[0], v[1], v[2], v[3], v[4], v[5]);
+            continue;
+        }
+        if (board->num_stairs == MAX_STAIRS) {
+            config_warning(&reader, reader.record_line, reader.record_column,
+                           "more than %d stairs", MAX_STAIRS);
+            break;
+        }
+        
+        board->stairs[board->num_stairs].start_floor = v[0];
+        board->stairs[board->num_stairs].start_width = v[1];
+        board->stairs[board->num_stairs].start_length = v[2];
+        board->stairs[board->num_stairs].end_floor = v[3];
+        board->stairs[board->num_stairs].end_width = v[4];
+        board->stairs[board->num_stairs].end_length = v[5];
+        board->num_stairs++;
+    }
+    
+    maze_build_transition_index(board);
+    build_ray_tables(board);
+    
+    board_printf(board, "Loaded %d stairs from %s\n", board->num_stairs, filename);
+    config_close(&reader);
+    return true;
+}
+
+static bool load_poles_from_file(Board* board, const char* filename) {
+    ConfigReader reader;
+    if (!config_open(&reader, filename, board->out)) {
+        board_printf(board, "Warning: Cannot open %s\n", filename);
+        return true;
+    }
+    
+    int v[4];
+    int count = 0;
+    reader.out = NULL;
+    while (config_next_record(&reader, v, 4) == 1) count++;
+    config_rewind(&reader, board->out);
+    
+    board->num_poles = 0;
+    board->poles = maze_board_alloc(board, count * sizeof(Pole));
+    if (board->poles == NULL) {
+        config_close(&reader);
+        return false;
+    }
+    
+    while (config_next_record(&reader, v, 4) == 1) {
+        if (v[0] <= v[1]) {
+            config_warning(&reader, reader.record_line, reader.record_column,
+                           "pole from floor %d to %d at [%d, %d] does not lead down",
+                           v[0], v[1], v[2], v[3]);
+            continue;
+        }
+        if (!maze_is_floor_accessible(board, v[0], v[2], v[3]) || !maze_is_floor_accessible(board, v[1], v[2], v[3])) {
+            config_warning(&reader, reader.record_line, reader.record_column,
+                           "pole from floor %d to %d at [%d, %d] has an end off the floor plan",
+                           v[0], v[1], v[2], v[3]);
+            continue;
+        }
+        
+        board->poles[board->num_poles].start_floor = v[0];
+        board->poles[board->num_poles].end_floor = v[1];
+        board->poles[board->num_poles].width = v[2];
+        board->poles[board->num_poles].length = v[3];
+        board->num_poles++;
+    }
+    
+    maze_build_transition_index(board);
+    build_ray_tables(board);
+    
+    board_printf(board, "Loaded %d poles from %s\n", board->num_poles, filename);
+    config_close(&reader);
+    return true;
+}
+
+static bool load_walls_from_file(Board* board, const char* filename) {
+    ConfigReader reader;
+    if (!config_open(&reader, filename, board->out)) {
+        board_printf(board, "Warning: Cannot open %s\n", filename);
+        return true;
+    }
+    
+    int v[5];
+    int count = 0;
+    reader.out = NULL;
+    while (config_next_record(&reader, v, 5) == 1) count++;
+    config_rewind(&reader, board->out);
+    
+    board->num_walls = 0;
+    board->walls = maze_board_alloc(board, count * sizeof(Wall));
+    if (board->walls == NULL) {
+        config_close(&reader);
+        return false;
+    }
+    
+    while (config_next_record(&reader, v, 5) == 1) {
+        if (!is_valid_position(board, v[0], v[1], v[2]) || !is_valid_position(board, v[0], v[3], v[4])) {
+            config_warning(&reader, reader.record_line, reader.record_column,
+                           "wall on floor %d from [%d, %d] to [%d, %d] leaves the maze",
+                           v[0], v[1], v[2], v[3], v[4]);
+            continue;
+        }
+        if (v[1] != v[3] && v[2] != v[4]) {
+            config_warning(&reader, reader.record_line, reader.record_column,
+                           "wall from [%d, %d] to [%d, %d] is not straight", v[1], v[2], v[3], v[4]);
+            continue;
+        }
+        
+        board->walls[board->num_walls].floor = v[0];
+        board->walls[board->num_walls].start_width = v[1];
+        board->walls[board->num_walls].start_length = v[2];
+        board->walls[board->num_walls].end_width = v[3];
+        board->walls[board->num_walls].end_length = v[4];
+        board->num_walls++;
+    }
+    
+    maze_build_adjacency_table(board);
+    build_ray_tables(board);
+    
+    board_printf(board, "Loaded %d walls from %s\n", board->num_walls, filename);
+    config_close(&reader);
+    return true;
+}
+
+static void load_flag_from_file(Board* board, const char* filename) {
+    ConfigReader reader;
+    if (!config_open(&reader, filename, board->out)) {
+        board_printf(board, "Warning: Cannot open %s\n", filename);
+        return;
+    }
+    
+    int v[3];
+    if (config_next_record(&reader, v, 3) != 1) {
+        board_printf(board, "Warning: Invalid flag file format\n");
+    } else if (!maze_is_floor_accessible(board, v[0], v[1], v[2])) {
+        config_warning(&reader, reader.record_line, reader.record_column,
+                       "flag [%d, %d, %d] is off the floor plan", v[0], v[1], v[2]);
+    } else {
+        board->flag_floor = v[0];
+        board->flag_width = v[1];
+        board->flag_length = v[2];
+        board_printf(board, "Flag loaded at [%d, %d, %d]\n", board->flag_floor, board->flag_width, board->flag_length);
+    }
+    
+    build_ray_tables(board);
+    config_close(&reader);
+}
+
+// Loads the text files from directory, or the current directory if NULL,
+// onto board and checks that the game can end.
+bool maze_load_board_files(Board* board, const char* directory) {
+    const char* names[] = {"board.txt", "stairs.txt", "poles.txt", "walls.txt", "flag.txt"};
+    char paths[5][4096];
+    for (int i = 0; i < 5; i++) {
+        if (directory != NULL) {
+            snprintf(paths[i], sizeof(paths[i]), "%s/%s", directory, names[i]);
+        } else {
+            snprintf(paths[i], sizeof(paths[i]), "%s", names[i]);
+        }
+    }
+    
+    if (!maze_load_floor_plan_from_file(board, paths[0]) || !load_stairs_from_file(board, paths[1]) ||
+        !load_poles_from_file(board, paths[2]) || !load_walls_from_file(board, paths[3])) {
+        return false;
+    }
+    load_flag_from_file(board, paths[4]);
+    if (!maze_build_distance_field(board)) return false;
+    
+    if (!flag_reachable(board)) {
+        board_error(board, "Error: The flag cannot be reached from the start cells or the Bawana\n");
+        return false;
+    }
+    return true;
+}
+
+void* maze_board_alloc(Board* board, size_t size) {
+    Arena* arena = &board->arena;
+    size_t offset = (arena->used + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1);
+    
+    if (offset + size > arena->capacity || arena->mapping != NULL) {
+        // Move the board to a bigger block and re-point its arrays there.
+        size_t capacity = arena->capacity * 2;
+        if (capacity < offset + size) capacity = offset + size;
+        if (capacity < 4096) capacity = 4096;
+        
+        size_t offsets[BOARD_ARRAY_COUNT];
+        board_offsets(board, offsets);
+        
+        void* block;
+        if (posix_memalign(&block, CACHE_LINE, capacity) != 0) {
+            board_error(board, "Error: Out of memory for a %zu byte board\n", capacity);
+            return NULL;
+        }
+        if (arena->used > 0) {
+            memcpy(block, arena->base, arena->used);
+        }
+        release_arena(arena);
+        
+        arena->base = block;
+        arena->capacity = capacity;
+        board_point_into(board, block, offsets);
+    }
+    
+    arena->used = offset + size;
+    memset(arena->base + offset, 0, size);
+    return arena->base + offset;
+}
+
+static void board_offsets(const Board* board, size_t offsets[]) {
+#define BOARD_ARRAY_OFFSET(name, count) \
+    offsets[BOARD_ARRAY_##name] = board->name != NULL ? (size_t)((const uint8_t*)board->name - board->arena.base) : NO_OFFSET;
+    BOARD_ARRAYS(BOARD_ARRAY_OFFSET)
+#undef BOARD_ARRAY_OFFSET
+}
+
+static void board_sizes(const Board* board, size_t sizes[]) {
+#define BOARD_ARRAY_SIZE(name, count) \
+    sizes[BOARD_ARRAY_##name] = (size_t)(count) * sizeof(*board->name);
+    BOARD_ARRAYS(BOARD_ARRAY_SIZE)
+#undef BOARD_ARRAY_SIZE
+}
+
+static void board_point_into(Board* board, uint8_t* base, const size_t offsets[]) {
+#define BOARD_ARRAY_POINT(name, count) \
+    board->name = offsets[BOARD_ARRAY_##name] != NO_OFFSET ? (void*)(base + offsets[BOARD_ARRAY_##name]) : NULL;
+    BOARD_ARRAYS(BOARD_ARRAY_POINT)
+#undef BOARD_ARRAY_POINT
+}
+
+static void release_arena(Arena* arena) {
+    if (arena->mapping != NULL) {
+        munmap(arena->mapping, arena->mapping_size);
+    } else {
+        free(arena->base);
+    }
+    arena->base = NULL;
+    arena->used = 0;
+    arena->capacity = 0;
+    arena->mapping = NULL;
+    arena->mapping_size = 0;
+}
+
+void maze_free_board(Board* board) {
+    release_arena(&board->arena);
+}
+
+// Gives copy its own arena holding the same board, so it can be re-rolled
+// without disturbing games that share the original.
+bool maze_clone_board(Board* copy, const Board* board) {
+    size_t offsets[BOARD_ARRAY_COUNT];
+    board_offsets(board, offsets);
+    
+    void* block;
+    size_t size = board->arena.used > 0 ? board->arena.used : CACHE_LINE;
+    if (posix_memalign(&block, CACHE_LINE, size) != 0) return false;
+    memcpy(block, board->arena.base, board->arena.used);
+    
+    *copy = *board;
+    copy->arena.base = block;
+    copy->arena.used = board->arena.used;
+    copy->arena.capacity = size;
+    copy->arena.mapping = NULL;
+    copy->arena.mapping_size = 0;
+    board_point_into(copy, block, offsets);
+    return true;
+}
+
+// Starts an empty board of the given size: every cell is off the floor
+// plan and there are no stairs, poles, walls or flag yet. Returns false if
+// the arena cannot grow to hold it.
+static bool set_board_dimensions(Board* board, int floors, int width, int length) {
+#define BOARD_ARRAY_CLEAR(name, count) board->name = NULL;
+    BOARD_ARRAYS(BOARD_ARRAY_CLEAR)
+#undef BOARD_ARRAY_CLEAR
+    board->arena.used = 0;
+    
+    board->num_floors = floors;
+    board->maze_width = width;
+    board->maze_length = length;
+    board->num_cells = floors * width * length;
+    board->num_stairs = 0;
+    board->num_poles = 0;
+    board->num_walls = 0;
+    board->flag_floor = -1;
+    board->flag_width = -1;
+    board->flag_length = -1;
+    
+    size_t cells = (size_t)board->num_cells;
+    board->floor_plan = maze_board_alloc(board, cells * sizeof(uint8_t));
+    board->maze = maze_board_alloc(board, cells * sizeof(Cell));
+    board->neighbours = maze_board_alloc(board, cells * sizeof(*board->neighbours));
+    board->stair_end_head = maze_board_alloc(board, cells * sizeof(int32_t));
+    board->first_pole = maze_board_alloc(board, cells * sizeof(int32_t));
+    board->plain_run = maze_board_alloc(board, cells * sizeof(*board->plain_run));
+    board->ray_cost = maze_board_alloc(board, cells * NUM_DIRECTIONS * sizeof(int16_t));
+    board->ray_bonus = maze_board_alloc(board, cells * NUM_DIRECTIONS * sizeof(int16_t));
+    board->flag_distance = maze_board_alloc(board, cells * sizeof(int32_t));
+    return board->floor_plan != NULL && board->maze != NULL && board->neighbours != NULL &&
+           board->stair_end_head != NULL && board->first_pole != NULL && board->plain_run != NULL &&
+           board->ray_cost != NULL && board->ray_bonus != NULL && board->flag_distance != NULL;
+}
+
+static void add_floor_area(Board* board, int floor, int start_width, int start_length, int end_width, int end_length) {
+    int min_w = start_width < end_width ? start_width : end_width;
+    int max_w = start_width > end_width ? start_width : end_width;
+    int min_l = start_length < end_length ? start_length : end_length;
+    int max_l = start_length > end_length ? start_length : end_length;
+    
+    for (int w = min_w; w <= max_w; w++) {
+        for (int l = min_l; l <= max_l; l++) {
+            board->floor_plan[CELL_INDEX(board, floor, w, l)] = 1;
+        }
+    }
+}
+
+// The original three floors: floor 0 is open, floor 1 keeps both ends and
+// a bridge down the middle, floor 2 covers the middle only.
+static bool use_classic_floor_plan(Board* board) {
+    if (!set_board_dimensions(board, CLASSIC_FLOORS, CLASSIC_WIDTH, CLASSIC_LENGTH)) return false;
+    add_floor_area(board, 0, 0, 0, 9, 24);
+    add_floor_area(board, 1, 0, 0, 9, 7);
+    add_floor_area(board, 1, 3, 8, 6, 16);
+    add_floor_area(board, 1, 0, 17, 9, 24);
+    add_floor_area(board, 2, 0, 8, 9, 16);
+    return true;
+}
+
+// Whether floor 0 opens every home, entry and Bawana cell and the Bawana
+// exit, which play puts players on without checking the plan.
+static bool has_fixed_areas(const Board* board) {
+    for (int w = bawana_area[0]; w <= bawana_area[2]; w++) {
+        for (int l = bawana_area[1]; l <= bawana_area[3]; l++) {
+            if (!maze_is_floor_accessible(board, 0, w, l)) return false;
+        }
+    }
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (!maze_is_floor_accessible(board, 0, maze_player_home[i][0], maze_player_home[i][1]) ||
+            !maze_is_floor_accessible(board, 0, maze_player_entry[i][0], maze_player_entry[i][1])) {
+            return false;
+        }
+    }
+    return maze_is_floor_accessible(board, 0, maze_bawana_exit[0], maze_bawana_exit[1]);
+}
+
+static uint64_t board_checksum(const uint8_t* data, size_t size) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+bool maze_save_board_file(const Board* board, const char* filename) {
+    size_t sizes[BOARD_ARRAY_COUNT];
+    board_sizes(board, sizes);
+    
+    BoardFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BOARD_FILE_MAGIC, 4);
+    header.version = BOARD_FILE_VERSION;
+    header.byte_order = BOARD_BYTE_ORDER;
+    header.header_size = sizeof(BoardFileHeader);
+    header.seed = board->seed;
+    header.floors = board->num_floors;
+    header.width = board->maze_width;
+    header.length = board->maze_length;
+    header.num_stairs = board->num_stairs;
+    header.num_poles = board->num_poles;
+    header.num_walls = board->num_walls;
+    header.flag_floor = board->flag_floor;
+    header.flag_width = board->flag_width;
+    header.flag_length = board->flag_length;
+    header.rules = board->rules;
+    header.arena_offset = (sizeof(BoardFileHeader) + CACHE_LINE - 1) & ~(uint32_t)(CACHE_LINE - 1);
+    
+    // Lay the arrays out back to back, dropping anything a reload orphaned.
+    size_t offset = 0;
+    for (int i = 0; i < BOARD_ARRAY_COUNT; i++) {
+        offset = (offset + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1);
+        header.sections[i].offset = (uint32_t)offset;
+        header.sections[i].size = (uint32_t)sizes[i];
+        offset += sizes[i];
+    }
+    header.arena_size = (uint32_t)offset;
+    header.file_size = header.arena_offset + header.arena_size;
+    
+    uint8_t* image = calloc(1, header.file_size);
+    if (image == NULL) {
+        board_printf(board, "Error: Out of memory compiling %s\n", filename);
+        return false;
+    }
+    
+    size_t offsets[BOARD_ARRAY_COUNT];
+    board_offsets(board, offsets);
+    for (int i = 0; i < BOARD_ARRAY_COUNT; i++) {
+        if (sizes[i] > 0) {
+            memcpy(image + header.arena_offset + header.sections[i].offset, board->arena.base + offsets[i], sizes[i]);
+        }
+    }
+    header.checksum = board_checksum(image + sizeof(BoardFileHeader), header.file_size - sizeof(BoardFileHeader));
+    memcpy(image, &header, sizeof(header));
+    
+    FILE* file = fopen(filename, "wb");
+    bool ok = file != NULL && fwrite(image, header.file_size, 1, file) == 1;
+    if (file != NULL && fclose(file) != 0) ok = false;
+    free(image);
+    
+    if (!ok) {
+        board_printf(board, "Error: Cannot write %s\n", filename);
+    }
+    return ok;
+}
+
+// Checks a compiled board image and takes its sizes, seed and flag into
+// board. Returns what is wrong with it, or NULL if it can be used, in
+// which case offsets[] locates each array within the image's arena.
+static const char* check_board_image(Board* board, const uint8_t* data, size_t size, size_t offsets[]) {
+    const BoardFileHeader* header = (const BoardFileHeader*)data;
+    if (data == NULL || size < sizeof(BoardFileHeader) || memcmp(header->magic, BOARD_FILE_MAGIC, 4) != 0) {
+        return "is not a compiled board";
+    } else if (header->version != BOARD_FILE_VERSION || header->byte_order != BOARD_BYTE_ORDER ||
+               header->header_size != sizeof(BoardFileHeader)) {
+        return "was compiled for another version or platform";
+    } else if (header->file_size != size || header->arena_offset < sizeof(BoardFileHeader) ||
+               header->arena_offset % CACHE_LINE != 0 || header->arena_size != size - header->arena_offset ||
+               header->checksum != board_checksum(data + sizeof(BoardFileHeader), size - sizeof(BoardFileHeader))) {
+        return "is truncated or corrupt";
+    } else if (header->floors < 1 || header->floors > MAX_DIMENSION ||
+               header->width < 1 || header->width > MAX_DIMENSION ||
+               header->length < 1 || header->length > MAX_DIMENSION ||
+               header->num_stairs < 0 || header->num_stairs > MAX_STAIRS ||
+               header->num_poles < 0 || header->num_walls < 0) {
+        return "has an impossible board size";
+    } else if (maze_rules_check(&header->rules) != NULL) {
+        return "has impossible rules";
+    }
+    
+    size_t sizes[BOARD_ARRAY_COUNT];
+    board->num_floors = header->floors;
+    board->maze_width = header->width;
+    board->maze_length = header->length;
+    board->num_cells = header->floors * header->width * header->length;
+    board->num_stairs = header->num_stairs;
+    board->num_poles = header->num_poles;
+    board->num_walls = header->num_walls;
+    board_sizes(board, sizes);
+    
+    for (int i = 0; i < BOARD_ARRAY_COUNT; i++) {
+        const BoardSection* section = &header->sections[i];
+        if (section->size != sizes[i] || section->offset % CACHE_LINE != 0 ||
+            section->offset > header->arena_size || section->size > header->arena_size - section->offset) {
+            return "has a section that does not match its header";
+        }
+        offsets[i] = section->offset;
+    }
+    
+    board->seed = header->seed;
+    board->flag_floor = header->flag_floor;
+    board->flag_width = header->flag_width;
+    board->flag_length = header->flag_length;
+    board->rules = header->rules;
+    return NULL;
+}
+
+// Checks every coordinate and index in a board's tables, once they point
+// into its image, against the board's size: play trusts them without
+// bounds checks, and the checksum only catches accidental damage.
+static const char* check_board_tables(const Board* board) {
+    int num_cells = board->num_cells;
+    int num_ends = board->num_stairs * 2;
+    
+    if (!is_valid_position(board, board->flag_floor, board->flag_width, board->flag_length)) {
+        return "has its flag off the board";
+    } else if (!has_fixed_areas(board)) {
+        return "does not cover the homes, entries, Bawana and its exit";
+    }
+    
+    for (int i = 0; i < board->num_stairs; i++) {
+        const Stair* stair = &board->stairs[i];
+        if (!is_valid_position(board, stair->start_floor, stair->start_width, stair->start_length) ||
+            !is_valid_position(board, stair->end_floor, stair->end_width, stair->end_length)) {
+            return "has a stair off the board";
+        }
+    }
+    for (int i = 0; i < board->num_poles; i++) {
+        const Pole* pole = &board->poles[i];
+        if (!is_valid_position(board, pole->start_floor, pole->width, pole->length) ||
+            !is_valid_position(board, pole->end_floor, pole->width, pole->length)) {
+            return "has a pole off the board";
+        }
+        if (pole->start_floor <= pole->end_floor) {
+            return "has a pole that does not lead down";
+        }
+    }
+    for (int i = 0; i < board->num_walls; i++) {
+        const Wall* wall = &board->walls[i];
+        if (!is_valid_position(board, wall->floor, wall->start_width, wall->start_length) ||
+            !is_valid_position(board, wall->floor, wall->end_width, wall->end_length)) {
+            return "has a wall off the board";
+        }
+    }
+    
+    // Stair ends are listed in increasing order, which also rules out a
+    // list that loops.
+    for (int end = 0; end < num_ends; end++) {
+        int next = board->stair_end_next[end];
+        if (next != -1 && (next <= end || next >= num_ends)) return "has a broken stair list";
+    }
+    
+    for (int cell = 0; cell < num_cells; cell++) {
+        int width = (cell / board->maze_length) % board->maze_width;
+        int length = cell % board->maze_length;
+        
+        if (CELL_EFFECT(board->maze[cell]) >= NUM_CELL_EFFECTS || CELL_BAWANA(board->maze[cell]) >= BAWANA_EFFECTS) {
+            return "has a cell with an unknown effect";
+        } else if (board->stair_end_head[cell] < -1 || board->stair_end_head[cell] >= num_ends) {
+            return "has a broken stair list";
+        } else if (board->first_pole[cell] < -1 || board->first_pole[cell] >= board->num_poles) {
+            return "has a cell pointing at a missing pole";
+        }
+        
+        for (int d = 0; d < NUM_DIRECTIONS; d++) {
+            int neighbour = board->neighbours[cell][d];
+            int run = board->plain_run[cell][d];
+            int run_width = width + run * ((d == EAST - NORTH) - (d == WEST - NORTH));
+            int run_length = length + run * ((d == SOUTH - NORTH) - (d == NORTH - NORTH));
+            
+            if (neighbour != NO_CELL && (neighbour < 0 || neighbour >= num_cells)) {
+                return "has a neighbour off the board";
+            } else if (run < 0 || run_width < 0 || run_width >= board->maze_width ||
+                       run_length < 0 || run_length >= board->maze_length) {
+                return "has a run off the board";
+            }
+        }
+    }
+    return NULL;
+}
+
+// Counterpart of maze_initialize_board for a compiled board. The file is mapped
+// copy-on-write and becomes the board's arena: after the checksum pass
+// nothing is parsed, rebuilt or copied.
+bool maze_initialize_board_from_file(Board* board, const char* filename, FILE* errors) {
+    memset(&board->arena, 0, sizeof(board->arena));
+    board->out = NULL;
+    board->errors = errors;
+    
+    int fd = open(filename, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        if (fd >= 0) close(fd);
+        board_error(board, "Error: Cannot open %s\n", filename);
+        return false;
+    }
+    
+    size_t size = (size_t)info.st_size;
+    uint8_t* data = NULL;
+    if (size >= sizeof(BoardFileHeader)) {
+        void* mapped = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) data = (uint8_t*)mapped;
+    }
+    close(fd);
+    
+    size_t offsets[BOARD_ARRAY_COUNT];
+    const char* problem = check_board_image(board, data, size, offsets);
+    if (problem != NULL) {
+        board_error(board, "Error: %s %s\n", filename, problem);
+        if (data != NULL) munmap(data, size);
+        return false;
+    }
+    
+    const BoardFileHeader* header = (const BoardFileHeader*)data;
+    board->arena.mapping = data;
+    board->arena.mapping_size = size;
+    board->arena.base = data + header->arena_offset;
+    board->arena.used = header->arena_size;
+    board->arena.capacity = header->arena_size;
+    board_point_into(board, board->arena.base, offsets);
+    
+    problem = check_board_tables(board);
+    if (problem != NULL) {
+        board_error(board, "Error: %s %s\n", filename, problem);
+        release_arena(&board->arena);
+        return false;
+    }
+    if (!flag_reachable(board)) {
+        board_error(board, "Error: %s has a flag that cannot be reached\n", filename);
+        release_arena(&board->arena);
+        return false;
+    }
+    return true;
+}
+
+// Like maze_initialize_board_from_file for an image already in memory, which
+// is copied; name is only used in messages.
+static bool initialize_board_from_memory(Board* board, const void* data, size_t size, const char* name, FILE* errors) {
+    memset(&board->arena, 0, sizeof(board->arena));
+    board->out = NULL;
+    board->errors = errors;
+    
+    size_t offsets[BOARD_ARRAY_COUNT];
+    const char* problem = check_board_image(board, data, size, offsets);
+    if (problem != NULL) {
+        board_error(board, "Error: %s %s\n", name, problem);
+        return false;
+    }
+    
+    const BoardFileHeader* header = (const BoardFileHeader*)data;
+    void* block;
+    if (posix_memalign(&block, CACHE_LINE, header->arena_size > 0 ? header->arena_size : CACHE_LINE) != 0) {
+        board_error(board, "Error: Out of memory for a %u byte board\n", header->arena_size);
+        return false;
+    }
+    memcpy(block, (const uint8_t*)data + header->arena_offset, header->arena_size);
+    
+    board->arena.base = block;
+    board->arena.used = header->arena_size;
+    board->arena.capacity = header->arena_size;
+    board_point_into(board, board->arena.base, offsets);
+    
+    problem = check_board_tables(board);
+    if (problem != NULL) {
+        board_error(board, "Error: %s %s\n", name, problem);
+        release_arena(&board->arena);
+        return false;
+    }
+    if (!flag_reachable(board)) {
+        board_error(board, "Error: %s has a flag that cannot be reached\n", name);
+        release_arena(&board->arena);
+        return false;
+    }
+    return true;
+}
+
+void maze_rules_default(Rules* rules) {
+    static const int32_t cell_mix[CELL_KINDS] = {25, 35, 25, 10, 5};
+    static const int32_t bawana_mix[BAWANA_EFFECTS] = {2, 2, 2, 2, 8};
+    
+    rules->initial_points = INITIAL_MOVEMENT_POINTS;
+    rules->max_points = MAX_MOVEMENT_POINTS;
+    rules->stair_flip_rounds = STAIR_DIRECTION_CHANGE_ROUNDS;
+    memcpy(rules->cell_mix, cell_mix, sizeof(cell_mix));
+    memcpy(rules->bawana_mix, bawana_mix, sizeof(bawana_mix));
+}
+
+// Returns what is wrong with rules, or NULL if a board can use them.
+const char* maze_rules_check(const Rules* rules) {
+    int cells = 0, bawana = 0;
+    for (int i = 0; i < CELL_KINDS; i++) {
+        if (rules->cell_mix[i] < 0) return "cell_mix has a negative share";
+        cells += rules->cell_mix[i];
+    }
+    for (int i = 0; i < BAWANA_EFFECTS; i++) {
+        if (rules->bawana_mix[i] < 0) return "bawana_mix has a negative count";
+        bawana += rules->bawana_mix[i];
+    }
+    
+    if (rules->max_points < 1 || rules->max_points > MAX_MOVEMENT_POINTS) {
+        return "max_points must be from 1 to " STRINGIFY(MAX_MOVEMENT_POINTS);
+    } else if (rules->initial_points < 1 || rules->initial_points > rules->max_points) {
+        return "initial_points must be from 1 to max_points";
+    } else if (rules->stair_flip_rounds < 1 || rules->stair_flip_rounds > STAIR_FLIP_LIMIT) {
+        return "stair_flip_rounds must be from 1 to " STRINGIFY(STAIR_FLIP_LIMIT);
+    } else if (cells != 100) {
+        return "cell_mix must add up to 100";
+    } else if (bawana != BAWANA_CELLS) {
+        return "bawana_mix must add up to " STRINGIFY(BAWANA_CELLS);
+    }
+    return NULL;
+}
+
+// Sets one rule from NAME=VALUE; cell_mix and bawana_mix take their
+// values separated by '/'. Returns what is wrong, or NULL. The result is
+// not checked as a whole; that is maze_rules_check's job.
+const char* maze_rules_set(Rules* rules, const char* assignment) {
+    static const struct {
+        const char* name;
+        size_t offset;
+        int count;
+    } fields[] = {
+        {"initial_points", offsetof(Rules, initial_points), 1},
+        {"max_points", offsetof(Rules, max_points), 1},
+        {"stair_flip_rounds", offsetof(Rules, stair_flip_rounds), 1},
+        {"cell_mix", offsetof(Rules, cell_mix), CELL_KINDS},
+        {"bawana_mix", offsetof(Rules, bawana_mix), BAWANA_EFFECTS},
+    };
+    
+    const char* equals = strchr(assignment, '=');
+    if (equals == NULL) return "is not NAME=VALUE";
+    
+    for (size_t f = 0; f < sizeof(fields) / sizeof(fields[0]); f++) {
+        if (strlen(fields[f].name) != (size_t)(equals - assignment) ||
+            strncmp(assignment, fields[f].name, equals - assignment) != 0) {
+            continue;
+        }
+        
+        int32_t values[BAWANA_EFFECTS > CELL_KINDS ? BAWANA_EFFECTS : CELL_KINDS];
+        const char* text = equals + 1;
+        for (int i = 0; i < fields[f].count; i++) {
+            char* end;
+            long value = strtol(text, &end, 10);
+            if (end == text || value < INT32_MIN || value > INT32_MAX ||
+                *end != (i + 1 < fields[f].count ? '/' : '\0')) {
+                return fields[f].count > 1 ? "needs its values separated by '/'" : "needs an integer value";
+            }
+            values[i] = (int32_t)value;
+            text = end + 1;
+        }
+        memcpy((char*)rules + fields[f].offset, values, fields[f].count * sizeof(int32_t));
+        return NULL;
+    }
+    return "is not a rule (initial_points, max_points, stair_flip_rounds, cell_mix or bawana_mix)";
+}
+
+bool maze_initialize_board(Board* board, unsigned int seed, FILE* errors) {
+    memset(&board->arena, 0, sizeof(board->arena));
+    maze_rules_default(&board->rules);
+    board->out = stdout;
+    board->errors = errors;
+    if (!use_classic_floor_plan(board)) {
+        maze_free_board(board);
+        return false;
+    }
+    
+    maze_build_adjacency_table(board);
+    maze_build_transition_index(board);
+    if (!maze_build_distance_field(board)) {
+        maze_free_board(board);
+        return false;
+    }
+    maze_roll_board(board, seed);
+    return true;
+}
+
+// Rolls the cell effects and the Bawana layout from seed's board stream.
+void maze_roll_board(Board* board, unsigned int seed) {
+    Rng rng;
+    maze_rng_seed(&rng, seed, RNG_STREAM_BOARD);
+    
+    board->seed = seed;
+    initialize_maze_cells(board, &rng);
+    initialize_bawana_area(board, &rng);
+    build_ray_tables(board);
+}
+
+// Starts a game on board. The game's dice come from seed's play stream, so
+// a board rolled from the same seed replays the original single game.
+void maze_start_game(GameState* game, const Board* board, unsigned int seed) {
+    game->board = board;
+    game->seed = seed;
+    game->game_over = false;
+    game->winner = '\0';
+    game->round_count = 0;
+    game->next_player = 0;
+    game->log_level = MAZE_LOG_STEP;
+    game->sink = text_event_sink;
+    game->sink_context = stdout;
+    game->script = NULL;
+    game->tape = NULL;
+#if MAZE_STATS
+    memset(&game->stats, 0, sizeof(game->stats));
+#endif
+    
+    memset(game->stairs_up, 0xFF, sizeof(game->stairs_up));
+    initialize_players(game);
+    
+    maze_rng_seed(&game->rng, seed, RNG_STREAM_BOARD);
+    game->rng = rng_split(&game->rng, RNG_STREAM_PLAY);
+}
+
+static void game_snapshot(const GameState* game, GameSnapshot* snapshot) {
+    memset(snapshot, 0, sizeof(*snapshot));
+    snapshot->seed = game->seed;
+    snapshot->round_count = game->round_count;
+    snapshot->game_over = game->game_over;
+    snapshot->winner = game->winner;
+    snapshot->next_player = (uint8_t)game->next_player;
+    snapshot->board_shape = board_shape(game->board);
+    snapshot->rng_key[0] = game->rng.key[0];
+    snapshot->rng_key[1] = game->rng.key[1];
+    snapshot->rng_stream = game->rng.stream;
+    snapshot->rng_position = game->rng.position;
+    
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        const Player* player = &game->players[i];
+        PlayerSnapshot* saved = &snapshot->players[i];
+        
+        saved->movement_points = player->movement_points;
+        saved->dice_throw_count = player->dice_throw_count;
+        saved->floor = (int8_t)player->floor;
+        saved->width = (int8_t)player->width;
+        saved->length = (int8_t)player->length;
+        saved->direction = (int8_t)player->direction;
+        saved->food_poisoning_turns = (int8_t)player->food_poisoning_turns;
+        saved->disoriented_turns = (int8_t)player->disoriented_turns;
+        saved->flags = (player->in_maze ? PLAYER_IN_MAZE : 0) |
+                       (player->triggered ? PLAYER_TRIGGERED : 0) |
+                       (player->in_bawana ? PLAYER_IN_BAWANA : 0);
+        saved->name = player->name;
+    }
+    
+    memcpy(snapshot->stairs_up, game->stairs_up, sizeof(snapshot->stairs_up));
+}
+
+// Hashes what a snapshot's positions and stair bits are checked against:
+// the board's size, its stair, pole and wall counts, its flag and its seed.
+// The full maze_board_fingerprint would hash every table, which is too slow
+// for game_hash on every recorded turn.
+static uint64_t board_shape(const Board* board) {
+    int32_t shape[10] = {
+        board->num_floors, board->maze_width, board->maze_length,
+        board->num_stairs, board->num_poles, board->num_walls,
+        board->flag_floor, board->flag_width, board->flag_length, (int32_t)board->seed
+    };
+    return board_checksum((const uint8_t*)shape, sizeof(shape));
+}
+
+// Whether snapshot holds a state a game on board could be in between
+// turns: every player on an open cell of this board, facing a direction,
+// with its counters in range, and a valid next player. A snapshot from
+// another board or a corrupted one would otherwise index past the board's
+// tables on the next turn.
+static bool snapshot_fits(const GameSnapshot* snapshot, const GameState* game) {
+    const Board* board = game->board;
+    if (snapshot->board_shape != board_shape(board) || snapshot->next_player >= MAX_PLAYERS ||
+        snapshot->round_count < 0) {
+        return false;
+    }
+    
+    bool known_winner = snapshot->winner == '\0';
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        const PlayerSnapshot* saved = &snapshot->players[i];
+        known_winner |= snapshot->winner == saved->name;
+        if (saved->name != game->players[i].name ||
+            !maze_is_floor_accessible(board, saved->floor, saved->width, saved->length) ||
+            saved->direction < NORTH || saved->direction > WEST ||
+            saved->movement_points < 1 || saved->movement_points > board->rules.max_points ||
+            saved->dice_throw_count < 0 ||
+            saved->food_poisoning_turns < 0 || saved->food_poisoning_turns > FOOD_POISONING_TURNS ||
+            saved->disoriented_turns < 0 || saved->disoriented_turns > DISORIENTED_TURNS ||
+            (saved->flags & ~(PLAYER_IN_MAZE | PLAYER_TRIGGERED | PLAYER_IN_BAWANA)) != 0) {
+            return false;
+        }
+    }
+    return known_winner;
+}
+
+// Puts game back in the state snapshot recorded. The game keeps its board
+// and its output settings; a snapshot that does not fit the board is
+// refused and the game left as it was.
+static bool game_restore(GameState* game, const GameSnapshot* snapshot) {
+    if (!snapshot_fits(snapshot, game)) return false;
+    
+    game->seed = snapshot->seed;
+    game->round_count = snapshot->round_count;
+    game->next_player = snapshot->next_player;
+    game->game_over = snapshot->game_over != 0;
+    game->winner = snapshot->winner;
+    game->rng.key[0] = snapshot->rng_key[0];
+    game->rng.key[1] = snapshot->rng_key[1];
+    game->rng.stream = snapshot->rng_stream;
+    game->rng.position = snapshot->rng_position;
+    game->rng.cached_block = UINT64_MAX;
+    
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        Player* player = &game->players[i];
+        const PlayerSnapshot* saved = &snapshot->players[i];
+        
+        player->movement_points = saved->movement_points;
+        player->dice_throw_count = saved->dice_throw_count;
+        player->floor = saved->floor;
+        player->width = saved->width;
+        player->length = saved->length;
+        player->direction = (Direction)saved->direction;
+        player->food_poisoning_turns = saved->food_poisoning_turns;
+        player->disoriented_turns = saved->disoriented_turns;
+        player->in_maze = (saved->flags & PLAYER_IN_MAZE) != 0;
+        player->triggered = (saved->flags & PLAYER_TRIGGERED) != 0;
+        player->in_bawana = (saved->flags & PLAYER_IN_BAWANA) != 0;
+        player->name = saved->name;
+    }
+    
+    memcpy(game->stairs_up, snapshot->stairs_up, sizeof(game->stairs_up));
+    return true;
+}
+
+// Copies parent into child, which then plays on by itself without
+// narrating. Branch 0 keeps the parent's dice, so the child replays what
+// the parent would do; any other branch gives the child its own dice
+// stream. A fork is a copy of a few hundred bytes and shares only the
+// read-only board, so forks can run on any threads.
+static void game_fork(GameState* child, const GameState* parent, uint64_t branch) {
+    *child = *parent;
+    child->log_level = MAZE_LOG_OFF;
+    child->tape = NULL;
+    
+    if (branch != 0) {
+        child->rng = rng_split(&parent->rng, fork_stream(&parent->rng, branch));
+    }
+}
+
+// A stream mixed from the parent's stream, its position and branch, so
+// siblings and nested forks draw independently of each other and of the
+// board and play streams.
+static uint64_t fork_stream(const Rng* rng, uint64_t branch) {
+    uint64_t z = rng->stream ^ (rng->position * 0x9E3779B97F4A7C15ull) ^ (branch * 0xD6E8FEB86659FD93ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z ^= z >> 31;
+    return z > RNG_STREAM_PLAY ? z : z + RNG_STREAM_PLAY + 1;
+}
+
+static void initialize_players(GameState* game) {
+    game->players[0].name = 'A';
+    game->players[0].floor = 0;
+    game->players[0].width = 6;
+    game->players[0].length = 12;
+    game->players[0].direction = NORTH;
+    game->players[0].in_maze = false;
+    game->players[0].dice_throw_count = 0;
+    game->players[0].movement_points = game->board->rules.initial_points;
+    game->players[0].food_poisoning_turns = 0;
+    game->players[0].disoriented_turns = 0;
+    game->players[0].triggered = false;
+    game->players[0].in_bawana = false;
+    
+    game->players[1].name = 'B';
+    game->players[1].floor = 0;
+    game->players[1].width = 9;
+    game->players[1].length = 8;
+    game->players[1].direction = WEST;
+    game->players[1].in_maze = false;
+    game->players[1].dice_throw_count = 0;
+    game->players[1].movement_points = game->board->rules.initial_points;
+    game->players[1].food_poisoning_turns = 0;
+    game->players[1].disoriented_turns = 0;
+    game->players[1].triggered = false;
+    game->players[1].in_bawana = false;
+    
+    game->players[2].name = 'C';
+    game->players[2].floor = 0;
+    game->players[2].width = 9;
+    game->players[2].length = 16;
+    game->players[2].direction = EAST;
+    game->players[2].in_maze = false;
+    game->players[2].dice_throw_count = 0;
+    game->players[2].movement_points = game->board->rules.initial_points;
+    game->players[2].food_poisoning_turns = 0;
+    game->players[2].disoriented_turns = 0;
+    game->players[2].triggered = false;
+    game->players[2].in_bawana = false;
+}
+
+static void initialize_maze_cells(Board* board, Rng* rng) {
+    const int32_t* mix = board->rules.cell_mix;
+    for (int i = 0; i < board->num_cells; i++) {
+        int rand_val = maze_rng_uniform(rng, 100);
+        int effect;
+        
+        if (rand_val < mix[0]) {
+            effect = CELL_CONSUMABLE(0);
+        } else if (rand_val < mix[0] + mix[1]) {
+            effect = CELL_CONSUMABLE(maze_rng_uniform(rng, 4) + 1);
+        } else if (rand_val < mix[0] + mix[1] + mix[2]) {
+            effect = CELL_BONUS_ADD(maze_rng_uniform(rng, 2) + 1);
+        } else if (rand_val < mix[0] + mix[1] + mix[2] + mix[3]) {
+            effect = CELL_BONUS_ADD(maze_rng_uniform(rng, 3) + 3);
+        } else {
+            effect = CELL_BONUS_MULTIPLY(maze_rng_uniform(rng, 2) + 2);
+        }
+        
+        board->maze[i] = MAKE_CELL(effect, BAWANA_RANDOM_POINTS);
+    }
+}
+
+static void initialize_bawana_area(Board* board, Rng* rng) {
+    BawanaEffect effects[BAWANA_CELLS];
+    int effect_count = 0;
+    int left[BAWANA_EFFECTS];
+    memcpy(left, board->rules.bawana_mix, sizeof(left));
+    
+    // The special effects go in turn, one of each per pass, then the
+    // random point cells: the default 2 of each and 8 random points.
+    while (effect_count < BAWANA_CELLS - left[BAWANA_RANDOM_POINTS]) {
+        for (int e = 0; e < BAWANA_RANDOM_POINTS; e++) {
+            if (left[e] > 0) {
+                left[e]--;
+                effects[effect_count++] = (BawanaEffect)e;
+            }
+        }
+    }
+    
+    while (effect_count < BAWANA_CELLS) {
+        effects[effect_count++] = BAWANA_RANDOM_POINTS;
+    }
+    
+    for (int i = 0; i < BAWANA_CELLS; i++) {
+        int j = maze_rng_uniform(rng, BAWANA_CELLS);
+        BawanaEffect temp = effects[i];
+        effects[i] = effects[j];
+        effects[j] = temp;
+    }
+    
+    int idx = 0;
+    for (int w = bawana_area[0]; w <= bawana_area[2]; w++) {
+        for (int l = bawana_area[1]; l <= bawana_area[3]; l++) {
+            if (idx < BAWANA_CELLS) {
+                Cell* cell = &board->maze[CELL_INDEX(board, 0, w, l)];
+                *cell = MAKE_CELL(CELL_EFFECT(*cell), effects[idx++]);
+            }
+        }
+    }
+}
+
+static int roll_movement_dice(GameState* game) {
+    return game_uniform(game, 6) + 1;
+}
+
+static Direction roll_direction_dice(GameState* game) {
+    int roll = game_uniform(game, 6);
+    switch(roll) {
+        case 0: return EMPTY;
+        case 1: return NORTH;
+        case 2: return EAST;
+        case 3: return SOUTH;
+        case 4: return WEST;
+        case 5: return EMPTY;
+        default: return EMPTY;
+    }
+}
+
+static Direction get_random_direction(GameState* game) {
+    Direction dirs[] = {NORTH, EAST, SOUTH, WEST};
+    return dirs[game_uniform(game, 4)];
+}
+
+static bool is_valid_position(const Board* board, int floor, int width, int length) {
+    return (floor >= 0 && floor < board->num_floors &&
+            width >= 0 && width < board->maze_width && 
+            length >= 0 && length < board->maze_length);
+}
+
+bool maze_is_floor_accessible(const Board* board, int floor, int width, int length) {
+    if (!is_valid_position(board, floor, width, length)) return false;
+    return board->floor_plan[CELL_INDEX(board, floor, width, length)] != 0;
+}
+
+bool maze_is_in_bawana(int width, int length) {
+    return (width >= bawana_area[0] && width <= bawana_area[2] &&
+            length >= bawana_area[1] && length <= bawana_area[3]);
+}
+
+bool maze_is_path_blocked_by_wall(const Board* board, int floor, int start_w, int start_l, int end_w, int end_l) {
+    for (int i = 0; i < board->num_walls; i++) {
+        Wall* wall = &board->walls[i];
+        if (wall->floor != floor) continue;
+        
+        if ((start_w == end_w && wall->start_width == wall->end_width && wall->start_width == start_w) ||
+            (start_l == end_l && wall->start_length == wall->end_length && wall->start_length == start_l)) {
+            
+            int min_w = (start_w < end_w) ? start_w : end_w;
+            int max_w = (start_w > end_w) ? start_w : end_w;
+            int min_l = (start_l < end_l) ? start_l : end_l;
+            int max_l = (start_l > end_l) ? start_l : end_l;
+            
+            int wall_min_w = (wall->start_width < wall->end_width) ? wall->start_width : wall->end_width;
+            int wall_max_w = (wall->start_width > wall->end_width) ? wall->start_width : wall->end_width;
+            int wall_min_l = (wall->start_length < wall->end_length) ? wall->start_length : wall->end_length;
+            int wall_max_l = (wall->start_length > wall->end_length) ? wall->start_length : wall->end_length;
+            
+            if (!(max_w < wall_min_w || min_w > wall_max_w || max_l < wall_min_l || min_l > wall_max_l)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static bool can_move_single_step(const Board* board, int floor, int from_w, int from_l, int to_w, int to_l) {
+    if (!maze_is_floor_accessible(board, floor, to_w, to_l)) return false;
+    if (maze_is_path_blocked_by_wall(board, floor, from_w, from_l, to_w, to_l)) return false;
+    return true;
+}
+
+void maze_build_adjacency_table(Board* board) {
+    for (int f = 0; f < board->num_floors; f++) {
+        for (int w = 0; w < board->maze_width; w++) {
+            for (int l = 0; l < board->maze_length; l++) {
+                for (int d = 0; d < NUM_DIRECTIONS; d++) {
+                    int to_w = w, to_l = l;
+                    
+                    switch(NORTH + d) {
+                        case NORTH: to_l--; break;
+                        case SOUTH: to_l++; break;
+                        case EAST:  to_w++; break;
+                        case WEST:  to_w--; break;
+                    }
+                    
+                    board->neighbours[CELL_INDEX(board, f, w, l)][d] = 
+                        can_move_single_step(board, f, w, l, to_w, to_l) ? CELL_INDEX(board, f, to_w, to_l) : NO_CELL;
+                }
+            }
+        }
+    }
+}
+
+static int next_cell(const Board* board, int floor, int width, int length, Direction dir) {
+    if (dir < NORTH || dir > WEST) return NO_CELL;
+    return board->neighbours[CELL_INDEX(board, floor, width, length)][dir - NORTH];
+}
+
+void maze_build_transition_index(Board* board) {
+    for (int cell = 0; cell < board->num_cells; cell++) {
+        board->stair_end_head[cell] = -1;
+        board->first_pole[cell] = -1;
+    }
+    
+    // Push stair ends in reverse so each cell lists them in file order,
+    // bottom end before top end, matching the original scan.
+    for (int end = board->num_stairs * 2 - 1; end >= 0; end--) {
+        Stair* stair = &board->stairs[end / 2];
+        int floor = (end & 1) ? stair->end_floor : stair->start_floor;
+        int width = (end & 1) ? stair->end_width : stair->start_width;
+        int length = (end & 1) ? stair->end_length : stair->start_length;
+        
+        board->stair_end_next[end] = -1;
+        if (!is_valid_position(board, floor, width, length)) continue;
+        
+        int cell = CELL_INDEX(board, floor, width, length);
+        board->stair_end_next[end] = board->stair_end_head[cell];
+        board->stair_end_head[cell] = end;
+    }
+    
+    for (int i = board->num_poles - 1; i >= 0; i--) {
+        Pole* pole = &board->poles[i];
+        for (int f = pole->end_floor + 1; f <= pole->start_floor; f++) {
+            if (is_valid_position(board, f, pole->width, pole->length)) {
+                board->first_pole[CELL_INDEX(board, f, pole->width, pole->length)] = i;
+            }
+        }
+    }
+}
+
+// The stair or pole a player landing on cell takes: stair i as i + 1,
+// pole j as -(j + 1), none as NO_TRANSITION.
+static int cell_transition(const GameState* game, int cell) {
+    const Board* board = game->board;
+    
+    for (int end = board->stair_end_head[cell]; end >= 0; end = board->stair_end_next[end]) {
+        bool is_top = (end & 1) != 0;
+        if (STAIR_UP(game, end / 2) != is_top) {
+            return end / 2 + 1;
+        }
+    }
+    
+    return board->first_pole[cell] >= 0 ? -(board->first_pole[cell] + 1) : NO_TRANSITION;
+}
+
+static bool is_event_cell(const Board* board, int cell) {
+    int floor = cell / (board->maze_width * board->maze_length);
+    int width = (cell / board->maze_length) % board->maze_width;
+    int length = cell % board->maze_length;
+    
+    return board->stair_end_head[cell] >= 0 ||
+           board->first_pole[cell] >= 0 ||
+           cell_effects[CELL_EFFECT(board->maze[cell])].multiplier > 1 ||
+           (floor == board->flag_floor && width == board->flag_width && length == board->flag_length) ||
+           maze_is_in_bawana(width, length);
+}
+
+static void build_ray_tables(Board* board) {
+    int num_cells = board->num_cells;
+    int cell_step[NUM_DIRECTIONS] = {-1, board->maze_length, 1, -board->maze_length};
+    
+    for (int d = 0; d < NUM_DIRECTIONS; d++) {
+        // Visit cells so the neighbour ahead (for runs) or behind (for the
+        // running sums) in direction d has already been filled in.
+        bool step_down = cell_step[d] < 0;
+        int16_t* ray_cost = board->ray_cost + d * num_cells;
+        int16_t* ray_bonus = board->ray_bonus + d * num_cells;
+        
+        for (int i = 0; i < num_cells; i++) {
+            int cell = step_down ? i : num_cells - 1 - i;
+            int next = board->neighbours[cell][d];
+            board->plain_run[cell][d] = (next == NO_CELL || is_event_cell(board, next)) ? 0 : board->plain_run[next][d] + 1;
+        }
+        
+        for (int i = 0; i < num_cells; i++) {
+            int cell = step_down ? num_cells - 1 - i : i;
+            int width = (cell / board->maze_length) % board->maze_width;
+            int length = cell % board->maze_length;
+            const CellEffect* effect = &cell_effects[CELL_EFFECT(board->maze[cell])];
+            int prev_width = width - (d == EAST - NORTH) + (d == WEST - NORTH);
+            int prev_length = length - (d == SOUTH - NORTH) + (d == NORTH - NORTH);
+            bool has_prev = prev_width >= 0 && prev_width < board->maze_width &&
+                            prev_length >= 0 && prev_length < board->maze_length;
+            int prev = cell - cell_step[d];
+            
+            ray_cost[cell] = (has_prev ? ray_cost[prev] : 0) + effect->cost;
+            ray_bonus[cell] = (has_prev ? ray_bonus[prev] : 0) + effect->bonus;
+        }
+    }
+}
+
+// Marks landing as a cell a step can land on to end up distance from the
+// flag, and queues the cells one step away from it.
+static void land_on(Board* board, int landing, int distance, uint8_t* landed, int32_t* queue, int* tail) {
+    static const int opposite[NUM_DIRECTIONS] = {SOUTH - NORTH, WEST - NORTH, NORTH - NORTH, EAST - NORTH};
+    
+    if (landed[landing]) return;
+    landed[landing] = 1;
+    
+    for (int d = 0; d < NUM_DIRECTIONS; d++) {
+        int from = board->neighbours[landing][opposite[d]];
+        if (from != NO_CELL && board->neighbours[from][d] == landing && board->flag_distance[from] == UNREACHABLE) {
+            board->flag_distance[from] = distance + 1;
+            queue[(*tail)++] = from;
+        }
+    }
+}
+
+// Breadth-first search back from the flag over the cells a player stands
+// on between steps. Landing on a stair end may carry the player to the
+// other end, landing on a pole slides it down and landing in the Bawana
+// may send it to the exit. Without a pole it may also stay where it
+// landed, since every stair there can point the wrong way. Returns false
+// if it runs out of memory.
+bool maze_build_distance_field(Board* board) {
+    int num_cells = board->num_cells;
+    int floor_size = board->maze_width * board->maze_length;
+    int32_t* queue = malloc(num_cells * sizeof(int32_t));
+    uint8_t* landed = calloc(num_cells, 1);
+    if (queue == NULL || landed == NULL) {
+        board_error(board, "Error: Out of memory for the distance field\n");
+        free(queue);
+        free(landed);
+        return false;
+    }
+    
+    for (int cell = 0; cell < num_cells; cell++) {
+        board->flag_distance[cell] = UNREACHABLE;
+    }
+    
+    int head = 0, tail = 0;
+    int flag = NO_CELL;
+    if (maze_is_floor_accessible(board, board->flag_floor, board->flag_width, board->flag_length)) {
+        flag = CELL_INDEX(board, board->flag_floor, board->flag_width, board->flag_length);
+        board->flag_distance[flag] = 0;
+        queue[tail++] = flag;
+    }
+    
+    while (head < tail) {
+        int cell = queue[head++];
+        int distance = board->flag_distance[cell];
+        int floor = cell / floor_size;
+        
+        // Reaching the flag ends the game before any pole is taken.
+        if (board->first_pole[cell] < 0 || cell == flag) {
+            land_on(board, cell, distance, landed, queue, &tail);
+        }
+        
+        for (int end = board->stair_end_head[cell]; end >= 0; end = board->stair_end_next[end]) {
+            const Stair* stair = &board->stairs[end / 2];
+            bool at_bottom = (end & 1) == 0;
+            int other_floor = at_bottom ? stair->end_floor : stair->start_floor;
+            int other_width = at_bottom ? stair->end_width : stair->start_width;
+            int other_length = at_bottom ? stair->end_length : stair->start_length;
+            
+            if (is_valid_position(board, other_floor, other_width, other_length)) {
+                land_on(board, CELL_INDEX(board, other_floor, other_width, other_length), distance, landed, queue, &tail);
+            }
+        }
+        
+        for (int above = cell + floor_size; above < num_cells; above += floor_size) {
+            int pole = board->first_pole[above];
+            if (pole >= 0 && board->poles[pole].end_floor == floor) {
+                land_on(board, above, distance, landed, queue, &tail);
+            }
+        }
+        
+        if (cell == CELL_INDEX(board, 0, maze_bawana_exit[0], maze_bawana_exit[1])) {
+            for (int other = 0; other < num_cells; other++) {
+                if (board->floor_plan[other] && maze_is_in_bawana((other / board->maze_length) % board->maze_width, other % board->maze_length)) {
+                    land_on(board, other, distance, landed, queue, &tail);
+                }
+            }
+        }
+    }
+    
+    free(queue);
+    free(landed);
+    return true;
+}
+
+// True when some player can reach the flag from where games put it: an
+// entry cell, a Bawana cell or the Bawana exit.
+static bool flag_reachable(const Board* board) {
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (board->flag_distance[CELL_INDEX(board, 0, maze_player_entry[i][0], maze_player_entry[i][1])] != UNREACHABLE) {
+            return true;
+        }
+    }
+    
+    for (int w = 0; w < board->maze_width; w++) {
+        for (int l = 0; l < board->maze_length; l++) {
+            if ((maze_is_in_bawana(w, l) || (w == maze_bawana_exit[0] && l == maze_bawana_exit[1])) &&
+                board->flag_distance[CELL_INDEX(board, 0, w, l)] != UNREACHABLE) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void maze_apply_cell_effects(GameState* game, Player* player, int floor, int width, int length, int* cost) {
+    if (!is_valid_position(game->board, floor, width, length)) {
+        *cost = 0;
+        return;
+    }
+    
+    const CellEffect* effect = &cell_effects[CELL_EFFECT(game->board->maze[CELL_INDEX(game->board, floor, width, length)])];
+    int points = player->movement_points;
+    int scaled = points <= 100 ? points * effect->multiplier : points + effect->large_bonus;
+    
+    player->movement_points = scaled - effect->cost + effect->bonus;
+    *cost = effect->cost;
+    
+    check_and_cap_movement_points(game, player);
+}
+
+static void apply_bawana_effect(GameState* game, Player* player) {
+    if (!maze_is_in_bawana(player->width, player->length)) return;
+    
+    BawanaEffect effect = CELL_BAWANA(game->board->maze[CELL_INDEX(game->board, 0, player->width, player->length)]);
+    int bonus = 0;
+    STAT_ADD(game, bawana_visits[effect], 1);
+    
+    switch(effect) {
+        case BAWANA_FOOD_POISONING:
+            player->food_poisoning_turns = FOOD_POISONING_TURNS;
+            break;
+            
+        case BAWANA_DISORIENTED:
+            player->movement_points += 50;
+            player->disoriented_turns = DISORIENTED_TURNS;
+            player->floor = 0;
+            player->width = 9;
+            player->length = 19;
+            player->direction = NORTH;
+            break;
+            
+        case BAWANA_TRIGGERED:
+            player->movement_points += 50;
+            player->triggered = true;
+            player->floor = 0;
+            player->width = 9;
+            player->length = 19;
+            player->direction = NORTH;
+            break;
+            
+        case BAWANA_HAPPY:
+            player->movement_points += 200;
+            player->floor = 0;
+            player->width = 9;
+            player->length = 19;
+            player->direction = NORTH;
+            break;
+            
+        case BAWANA_RANDOM_POINTS:
+        default:
+            bonus = game_uniform(game, 91) + 10; 
+            player->movement_points += bonus;
+            break;
+    }
+    
+    if (LOG_ENABLED(game, MAZE_LOG_STEP)) {
+        MazeEvent event = make_event(MAZE_EVENT_BAWANA_EFFECT, player);
+        event.count = (int8_t)effect;
+        event.amount = (int16_t)bonus;
+        emit_event(game, &event);
+    }
+    
+    check_and_cap_movement_points(game, player);
+    player->in_bawana = false;
+}
+
+bool maze_check_and_use_stairs_poles(GameState* game, Player* player) {
+    int transition = cell_transition(game, CELL_INDEX(game->board, player->floor, player->width, player->length));
+    
+    if (transition == NO_TRANSITION) return false;
+    
+    STAT_ADD(game, stairs_used, transition > 0);
+    STAT_ADD(game, poles_used, transition < 0);
+    int from_floor = player->floor, from_width = player->width, from_length = player->length;
+    
+    if (transition > 0) {
+        const Stair* stair = &game->board->stairs[transition - 1];
+        
+        if (STAIR_UP(game, transition - 1)) {
+            player->floor = stair->end_floor;
+            player->width = stair->end_width;
+            player->length = stair->end_length;
+        } else {
+            player->floor = stair->start_floor;
+            player->width = stair->start_width;
+            player->length = stair->start_length;
+        }
+    } else {
+        player->floor = game->board->poles[-transition - 1].end_floor;
+    }
+    
+    if (LOG_ENABLED(game, MAZE_LOG_STEP)) {
+        MazeEvent event = make_event(transition > 0 ? MAZE_EVENT_STAIR : MAZE_EVENT_POLE, player);
+        event.floor = (int8_t)from_floor;
+        event.width = (int8_t)from_width;
+        event.length = (int8_t)from_length;
+        event.to_floor = (int8_t)player->floor;
+        event.to_width = (int8_t)player->width;
+        event.to_length = (int8_t)player->length;
+        emit_event(game, &event);
+    }
+    return true;
+}
+
+static void capture_player(GameState* game, int capturer_index, int captured_index) {
+    Player* captured = &game->players[captured_index];
+    STAT_ADD(game, captures, 1);
+    
+    if (LOG_ENABLED(game, MAZE_LOG_STEP)) {
+        MazeEvent event = make_event(MAZE_EVENT_CAPTURE, &game->players[capturer_index]);
+        event.count = captured->name;
+        emit_event(game, &event);
+    }
+    
+    captured->in_maze = false;
+    captured->dice_throw_count = 0;
+    captured->floor = 0;
+    
+    switch(captured->name) {
+        case 'A': 
+            captured->width = 6; 
+            captured->length = 12; 
+            captured->direction = NORTH;
+            break;
+        case 'B': 
+            captured->width = 9; 
+            captured->length = 8; 
+            captured->direction = WEST;
+            break;
+        case 'C': 
+            captured->width = 9; 
+            captured->length = 16; 
+            captured->direction = EAST;
+            break;
+    }
+    
+    captured->food_poisoning_turns = 0;
+    captured->disoriented_turns = 0;
+    captured->triggered = false;
+    captured->in_bawana = false;
+}
+
+void maze_change_stair_directions(GameState* game) {
+    for (int i = 0; i < game->board->num_stairs; i++) {
+        uint64_t bit = 1ull << (i % 64);
+        if (game_uniform(game, 2) == 0) {
+            game->stairs_up[i / 64] |= bit;
+        } else {
+            game->stairs_up[i / 64] &= ~bit;
+        }
+    }
+}
+
+static void transport_to_bawana(GameState* game, Player* player) {
+    STAT_ADD(game, bawana_transports, 1);
+    
+    if (LOG_ENABLED(game, MAZE_LOG_STEP)) {
+        MazeEvent event = make_event(MAZE_EVENT_BAWANA_TRANSPORT, player);
+        emit_event(game, &event);
+    }
+    
+    int bawana_positions[][2] = {
+        {6,20}, {6,21}, {6,22}, {6,23}, {6,24},
+        {7,20}, {7,21}, {7,22}, {7,23}, {7,24},
+        {8,20}, {8,21}, {8,22}, {8,23}, {8,24},
+        {9,20}, {9,21}, {9,22}, {9,23}, {9,24}
+    };
+    
+    int valid_positions = sizeof(bawana_positions) / (2 * sizeof(int));
+    int idx = game_uniform(game, valid_positions);
+    
+    player->floor = 0;
+    player->width = bawana_positions[idx][0];
+    player->length = bawana_positions[idx][1];
+    player->in_bawana = true;
+    player->movement_points = 10; 
+    
+    apply_bawana_effect(game, player);
+}
+
+void maze_move_player_with_effects(GameState* game, Player* player, Direction dir, int steps) {
+    int effective_steps = steps;
+    int total_cost = 0;
+    int cells_moved = 0;
+    
+    if (player->triggered) {
+        effective_steps *= 2;
+    }
+    
+    for (int step = 0; step < effective_steps; step++) {
+        int old_width = player->width;
+        int old_length = player->length;
+        int new_width = player->width;
+        int new_length = player->length;
+        
+        switch(dir) {
+            case NORTH: new_length--; break;
+            case SOUTH: new_length++; break;
+            case EAST:  new_width++; break;
+            case WEST:  new_width--; break;
+            default: return;
+        }
+        
+        // Cross a stretch of plain cells in one go. Only taken when the
+        // points can neither hit the cap nor run out part-way, so the result
+        // matches stepping through the cells one at a time.
+        int from = CELL_INDEX(game->board, player->floor, old_width, old_length);
+        int run = game->board->plain_run[from][dir - NORTH];
+        if (run > effective_steps - step) run = effective_steps - step;
+        
+        if (run > 1) {
+            int to = from + run * (CELL_INDEX(game->board, player->floor, new_width, new_length) - from);
+            int ray = (dir - NORTH) * game->board->num_cells;
+            int run_cost = game->board->ray_cost[ray + to] - game->board->ray_cost[ray + from];
+            int run_bonus = game->board->ray_bonus[ray + to] - game->board->ray_bonus[ray + from];
+            
+            if (player->movement_points - run_cost > 0 && 
+                player->movement_points + run_bonus <= game->board->rules.max_points) {
+                player->movement_points += run_bonus - run_cost;
+                player->width = old_width + run * (new_width - old_width);
+                player->length = old_length + run * (new_length - old_length);
+                total_cost += run_cost;
+                cells_moved += run;
+                // Counted as the checks stepping through the run would make.
+                STAT_ADD(game, wall_checks, run);
+                STAT_ADD(game, steps, run);
+                step += run - 1;
+                continue;
+            }
+        }
+        
+        STAT_ADD(game, wall_checks, 1);
+        if (next_cell(game->board, player->floor, old_width, old_length, dir) == NO_CELL) {
+            STAT_ADD(game, blocked_moves, 1);
+            if (step == 0) {
+                STAT_ADD(game, wall_bumps, 1);
+                if (LOG_ENABLED(game, MAZE_LOG_STEP)) {
+                    MazeEvent event = make_event(MAZE_EVENT_WALL_BUMP, player);
+                    event.direction = (int8_t)dir;
+                    emit_event(game, &event);
+                }
+                
+                total_cost = 2; 
+                player->movement_points -= 2;
+                check_and_cap_movement_points(game, player);
+            }
+            break;
+        }
+        
+        player->width = new_width;
+        player->length = new_length;
+        cells_moved++;
+        STAT_ADD(game, steps, 1);
+        
+        int step_cost = 0;
+        maze_apply_cell_effects(game, player, player->floor, player->width, player->length, &step_cost);
+        total_cost += step_cost;
+        
+        if (player->floor == game->board->flag_floor && 
+            player->width == game->board->flag_width && 
+            player->length == game->board->flag_length) {
+            if (LOG_ENABLED(game, MAZE_LOG_SUMMARY)) {
+                MazeEvent event = make_event(MAZE_EVENT_FLAG_CAPTURE, player);
+                emit_event(game, &event);
+            }
+            game->game_over = true;
+            game->winner = player->name;
+            return;
+        }
+        
+        if (player->movement_points <= 0) {
+            break;
+        }
+        
+        if (maze_check_and_use_stairs_poles(game, player)) {
+            if (player->floor == game->board->flag_floor && 
+                player->width == game->board->flag_width && 
+                player->length == game->board->flag_length) {
+                if (LOG_ENABLED(game, MAZE_LOG_SUMMARY)) {
+                    MazeEvent event = make_event(MAZE_EVENT_FLAG_CAPTURE, player);
+                    emit_event(game, &event);
+                }
+                game->game_over = true;
+                game->winner = player->name;
+                return;
+            }
+            
+            int remaining_steps = effective_steps - step - 1;
+            if (remaining_steps > 0) {
+                maze_move_player_with_effects(game, player, dir, remaining_steps);
+                return;
+            }
+        }
+        
+        if (maze_is_in_bawana(player->width, player->length)) {
+            apply_bawana_effect(game, player);
+            break;
+        }
+    }
+    
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        Player* other = &game->players[i];
+        if (other != player && other->in_maze && 
+            other->floor == player->floor && 
+            other->width == player->width && 
+            other->length == player->length) {
+            
+            int capturer_idx = -1;
+            for (int j = 0; j < MAX_PLAYERS; j++) {
+                if (&game->players[j] == player) {
+                    capturer_idx = j;
+                    break;
+                }
+            }
+            if (capturer_idx >= 0) {
+                capture_player(game, capturer_idx, i);
+            }
+            break;
+        }
+    }
+    
+    if ((cells_moved > 0 || total_cost > 0) && LOG_ENABLED(game, MAZE_LOG_TURN)) {
+        MazeEvent event = make_event(MAZE_EVENT_MOVE_SUMMARY, player);
+        event.count = (int8_t)cells_moved;
+        event.amount = (int16_t)total_cost;
+        event.value = player->movement_points;
+        emit_event(game, &event);
+    }
+}
+
+static void print_game_state(GameState* game, int level) {
+    if (!LOG_ENABLED(game, level)) return;
+    
+    MazeEvent event = make_event(MAZE_EVENT_STATE_BEGIN, NULL);
+    event.value = game->round_count;
+    emit_event(game, &event);
+    
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        print_player_status(game, &game->players[i]);
+    }
+    
+    event = make_event(MAZE_EVENT_STATE_END, NULL);
+    event.floor = (int8_t)game->board->flag_floor;
+    event.width = (int8_t)game->board->flag_width;
+    event.length = (int8_t)game->board->flag_length;
+    emit_event(game, &event);
+}
+
+static void print_player_status(GameState* game, Player* player) {
+    MazeEvent event = make_event(MAZE_EVENT_PLAYER_STATUS, player);
+    
+    event.count = (player->in_maze ? MAZE_STATUS_IN_MAZE : 0) |
+                  (player->triggered ? MAZE_STATUS_TRIGGERED : 0) |
+                  (player->in_bawana ? MAZE_STATUS_IN_BAWANA : 0);
+    event.to_floor = (int8_t)player->food_poisoning_turns;
+    event.to_width = (int8_t)player->disoriented_turns;
+    event.amount = (int16_t)player->movement_points;
+    event.value = player->dice_throw_count;
+    emit_event(game, &event);
+}
+
+static const char* direction_to_string(Direction dir) {
+    switch(dir) {
+        case NORTH: return "North";
+        case EAST:  return "East";
+        case SOUTH: return "South";
+        case WEST:  return "West";
+        default:    return "Unknown";
+    }
+}
+
+static const char* get_cell_type_name(BawanaEffect effect) {
+    switch(effect) {
+        case BAWANA_FOOD_POISONING: return "food poisoning cell";
+        case BAWANA_DISORIENTED: return "disorientation cell";
+        case BAWANA_TRIGGERED: return "triggering cell";
+        case BAWANA_HAPPY: return "happy cell";
+        case BAWANA_RANDOM_POINTS: return "random points cell";
+        default: return "unknown cell";
+    }
+}
+
+void maze_play_turn(GameState* game, int player_index) {
+    Player* player = &game->players[player_index];
+    STAT_ADD(game, turns, 1);
+    
+    if (player->food_poisoning_turns > 0) {
+        if (LOG_ENABLED(game, MAZE_LOG_TURN)) {
+            MazeEvent event = make_event(MAZE_EVENT_POISON_SKIP, player);
+            emit_event(game, &event);
+        }
+        player->food_poisoning_turns--;
+        
+        if (player->food_poisoning_turns == 0) {
+            if (LOG_ENABLED(game, MAZE_LOG_TURN)) {
+                MazeEvent event = make_event(MAZE_EVENT_POISON_RECOVERED, player);
+                emit_event(game, &event);
+            }
+            transport_to_bawana(game, player);
+        }
+        return;
+    }
+    
+    if (player->in_bawana) {
+        apply_bawana_effect(game, player);
+        return;
+    }
+    
+    if (!player->in_maze) {
+        int roll = roll_movement_dice(game);
+        STAT_ADD(game, entry_rolls, 1);
+        
+        if (roll == 6) {
+            player->in_maze = true;
+            player->dice_throw_count = 1;
+            
+            switch(player->name) {
+                case 'A': player->width = 5; player->length = 12; break;
+                case 'B': player->width = 9; player->length = 7; break;
+                case 'C': player->width = 9; player->length = 17; break;
+            }
+            
+            if (LOG_ENABLED(game, MAZE_LOG_TURN)) {
+                MazeEvent event = make_event(MAZE_EVENT_ENTRY_ROLL, player);
+                event.amount = (int16_t)roll;
+                emit_event(game, &event);
+            }
+            
+            int cost = 0;
+            maze_apply_cell_effects(game, player, player->floor, player->width, player->length, &cost);
+            
+            if (LOG_ENABLED(game, MAZE_LOG_TURN)) {
+                MazeEvent event = make_event(MAZE_EVENT_MOVE_SUMMARY, player);
+                event.count = 1;
+                event.amount = (int16_t)cost;
+                event.value = player->movement_points;
+                emit_event(game, &event);
+            }
+        } else {
+            if (LOG_ENABLED(game, MAZE_LOG_TURN)) {
+                MazeEvent event = make_event(MAZE_EVENT_ENTRY_ROLL, player);
+                event.amount = (int16_t)roll;
+                emit_event(game, &event);
+            }
+            
+            player->movement_points -= 2;
+            check_and_cap_movement_points(game, player);
+        }
+    } else {
+        int movement_roll = roll_movement_dice(game);
+        Direction movement_dir = player->direction;
+        
+        player->dice_throw_count++;
+        
+        if (player->disoriented_turns > 0) {
+            movement_dir = get_random_direction(game);
+            player->disoriented_turns--;
+            
+            if (LOG_ENABLED(game, MAZE_LOG_TURN)) {
+                MazeEvent event = make_event(MAZE_EVENT_DISORIENTED_ROLL, player);
+                event.direction = (int8_t)movement_dir;
+                event.amount = (int16_t)movement_roll;
+                emit_event(game, &event);
+            }
+            
+            STAT_TIME(game, move, maze_move_player_with_effects(game, player, movement_dir, movement_roll));
+            
+            if (LOG_ENABLED(game, MAZE_LOG_TURN)) {
+                MazeEvent event = make_event(MAZE_EVENT_POSITION, player);
+                emit_event(game, &event);
+                
+                if (player->disoriented_turns == 0) {
+                    event = make_event(MAZE_EVENT_DISORIENT_RECOVERED, player);
+                    emit_event(game, &event);
+                }
+            }
+        } else {
+            Direction dir_roll = EMPTY;
+            bool rolled_direction = player->dice_throw_count % 4 == 0;
+            
+            if (rolled_direction) {
+                dir_roll = roll_direction_dice(game);
+                
+                if (dir_roll != EMPTY) {
+                    player->direction = dir_roll;
+                    movement_dir = dir_roll;
+                }
+            }
+            
+            if (LOG_ENABLED(game, MAZE_LOG_TURN)) {
+                MazeEvent event = make_event(rolled_direction ? MAZE_EVENT_DIRECTION_ROLL :
+                                             player->triggered ? MAZE_EVENT_TRIGGERED_ROLL : MAZE_EVENT_MOVE_ROLL, player);
+                event.count = (int8_t)dir_roll;
+                event.direction = (int8_t)movement_dir;
+                event.amount = (int16_t)movement_roll;
+                emit_event(game, &event);
+            }
+            
+            STAT_ADD(game, wall_checks, 1);
+            if (next_cell(game->board, player->floor, player->width, player->length, movement_dir) == NO_CELL) {
+                STAT_ADD(game, blocked_moves, 1);
+                STAT_ADD(game, wall_bumps, 1);
+                
+                if (LOG_ENABLED(game, MAZE_LOG_TURN)) {
+                    MazeEvent event = make_event(MAZE_EVENT_BLOCKED, player);
+                    event.direction = (int8_t)movement_dir;
+                    event.amount = (int16_t)movement_roll;
+                    emit_event(game, &event);
+                }
+                
+                player->movement_points -= 2;
+                
+                if (LOG_ENABLED(game, MAZE_LOG_TURN)) {
+                    MazeEvent event = make_event(MAZE_EVENT_MOVE_SUMMARY, player);
+                    event.amount = 2;
+                    event.value = player->movement_points;
+                    emit_event(game, &event);
+                }
+                
+                check_and_cap_movement_points(game, player);
+            } else {
+                STAT_TIME(game, move, maze_move_player_with_effects(game, player, movement_dir, movement_roll));
+                
+                if (LOG_ENABLED(game, MAZE_LOG_TURN)) {
+                    MazeEvent event = make_event(MAZE_EVENT_POSITION, player);
+                    emit_event(game, &event);
+                }
+            }
+        }
+        
+        if (player->triggered && player->dice_throw_count % 4 == 0) {
+            player->triggered = false;
+        }
+    }
+}
+
+// Plays whoever is next, first starting a new round (and flipping the
+// stairs when due) if that is the first player.
+void maze_play_next_turn(GameState* game) {
+    if (game->next_player == 0) {
+        game->round_count++;
+        
+        if (game->round_count % game->board->rules.stair_flip_rounds == 0) {
+            maze_change_stair_directions(game);
+            
+            if (LOG_ENABLED(game, MAZE_LOG_TURN)) {
+                MazeEvent event = make_event(MAZE_EVENT_STAIR_FLIP, NULL);
+                event.value = game->round_count;
+                emit_event(game, &event);
+            }
+        }
+    }
+    
+    int i = game->next_player;
+    if (LOG_ENABLED(game, MAZE_LOG_TURN)) {
+        MazeEvent event = make_event(MAZE_EVENT_TURN_START, &game->players[i]);
+        event.value = game->round_count;
+        emit_event(game, &event);
+    }
+    
+    STAT_TIME(game, turn, maze_play_turn(game, i));
+    
+    if (game->tape != NULL) {
+        tape_turn(game);
+    }
+    
+    if (game->game_over) {
+        STAT_ADD(game, games, 1);
+        
+        if (game->winner != '\0' && LOG_ENABLED(game, MAZE_LOG_SUMMARY)) {
+            MazeEvent event = make_event(MAZE_EVENT_GAME_WON, NULL);
+            event.player = game->winner;
+            emit_event(game, &event);
+        }
+        return;
+    }
+    
+    game->next_player = (i + 1) % MAX_PLAYERS;
+    if (game->next_player == 0 && game->round_count % 10 == 0) {
+        print_game_state(game, MAZE_LOG_TURN);
+    }
+}
+
+void maze_play_game(GameState* game) {
+    while (!game->game_over) {
+        maze_play_next_turn(game);
+    }
+    
+    print_game_state(game, MAZE_LOG_SUMMARY);
+}
+
+static int script_draw(DrawScript* script, uint32_t bound) {
+    if (script->used >= script->capacity) {
+        script->overflow = true;
+        return 0;
+    }
+    
+    int i = script->used++;
+    if (i >= script->length) {
+        script->values[i] = 0;
+        script->bounds[i] = bound;
+    }
+    return (int)script->values[i];
+}
+
+#if MAZE_STATS >= 2
+static uint64_t stats_clock(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+#endif
+}
+#endif
+
+// Identifies a board by its contents, however it was loaded.
+uint64_t maze_board_fingerprint(const Board* board) {
+    int32_t shape[6] = {board->num_floors, board->maze_width, board->maze_length,
+                        board->flag_floor, board->flag_width, board->flag_length};
+    size_t sizes[BOARD_ARRAY_COUNT];
+    board_sizes(board, sizes);
+    
+    uint64_t hash = board_checksum((const uint8_t*)shape, sizeof(shape));
+    hash = (hash * 0x100000001b3ull) ^ board_checksum((const uint8_t*)&board->rules, sizeof(board->rules));
+#define BOARD_ARRAY_HASH(name, count) \
+    if (board->name != NULL) hash = (hash * 0x100000001b3ull) ^ board_checksum((const uint8_t*)board->name, sizes[BOARD_ARRAY_##name]);
+    BOARD_ARRAYS(BOARD_ARRAY_HASH)
+#undef BOARD_ARRAY_HASH
+    return hash;
+}
+
+// Hashes the play state without the dice: a replay never touches the
+// generator, and an engine may draw from it differently as long as the
+// draws on the tape come out the same.
+static uint32_t game_hash(const GameState* game) {
+    GameSnapshot snapshot;
+    game_snapshot(game, &snapshot);
+    snapshot.rng_key[0] = snapshot.rng_key[1] = 0;
+    snapshot.rng_stream = 0;
+    snapshot.rng_position = 0;
+    
+    uint64_t hash = board_checksum((const uint8_t*)&snapshot, sizeof(snapshot));
+    return (uint32_t)(hash ^ (hash >> 32));
+}
+
+// Attaches an empty tape that records game's draws from here on.
+void maze_tape_start(DiceTape* tape, const GameState* game) {
+    memset(tape, 0, sizeof(*tape));
+    tape->seed = game->seed;
+    tape->board_hash = maze_board_fingerprint(game->board);
+}
+
+static void tape_append(DiceTape* tape, uint32_t bound, uint32_t value) {
+    if (tape->length == tape->capacity) {
+        size_t capacity = tape->capacity > 0 ? tape->capacity * 2 : 4096;
+        TapeRecord* records = realloc(tape->records, capacity * sizeof(TapeRecord));
+        if (records == NULL) {
+            tape->diverged = true;
+            return;
+        }
+        tape->records = records;
+        tape->capacity = capacity;
+    }
+    tape->records[tape->length].bound = bound;
+    tape->records[tape->length].value = value;
+    tape->length++;
+}
+
+// Marks a replay as diverged and ends the game, so play stops on the turn
+// at fault.
+static void tape_diverge(GameState* game, const char* format, ...) {
+    DiceTape* tape = game->tape;
+    va_list args;
+    
+    if (!tape->diverged && tape->out != NULL) {
+        fprintf(tape->out, "Replay diverged at turn %llu (round %d): ", (unsigned long long)tape->turns + 1, game->round_count);
+        va_start(args, format);
+        vfprintf(tape->out, format, args);
+        va_end(args);
+        fprintf(tape->out, "\n");
+    }
+    tape->diverged = true;
+    game->game_over = true;
+}
+
+static int tape_draw(GameState* game, uint32_t bound) {
+    DiceTape* tape = game->tape;
+    
+    if (!tape->replay) {
+        int value = maze_rng_uniform(&game->rng, bound);
+        tape_append(tape, bound, (uint32_t)value);
+        return value;
+    }
+    
+    if (tape->diverged) return 0;
+    if (tape->position >= tape->length) {
+        tape_diverge(game, "the tape ran out of draws");
+        return 0;
+    }
+    
+    const TapeRecord* record = &tape->records[tape->position];
+    if (record->bound != bound) {
+        if (record->bound == TAPE_TURN) {
+            tape_diverge(game, "a draw in [0, %u) after the recorded turn ended", bound);
+        } else {
+            tape_diverge(game, "a draw in [0, %u) where the tape has one in [0, %u)", bound, record->bound);
+        }
+        return 0;
+    }
+    tape->position++;
+    return (int)record->value;
+}
+
+// Ends a turn on the tape: records the state hash, or on replay checks it
+// against the recorded one.
+static void tape_turn(GameState* game) {
+    DiceTape* tape = game->tape;
+    uint32_t hash = game_hash(game);
+    
+    if (!tape->replay) {
+        tape_append(tape, TAPE_TURN, hash);
+        tape->turns++;
+        return;
+    }
+    
+    if (tape->diverged) return;
+    const TapeRecord* record = tape->position < tape->length ? &tape->records[tape->position] : NULL;
+    
+    if (record == NULL || record->bound != TAPE_TURN) {
+        tape_diverge(game, "the turn ended where the tape has more draws");
+    } else if (record->value != hash) {
+        tape_diverge(game, "state hash %08x, recorded %08x", hash, record->value);
+    } else {
+        tape->position++;
+        tape->turns++;
+        
+        if (game->game_over && tape->position < tape->length) {
+            tape_diverge(game, "the game ended where the tape goes on");
+        }
+    }
+}
+
+// The embedding API wraps the engine's own structures; see maze_game.h.
+// A MazeSnapshot is a GameSnapshot in a buffer of fixed public size.
+STATIC_ASSERT(sizeof(GameSnapshot) <= sizeof(MazeSnapshot), snapshot_fits);
+struct MazeBoard {
+    Board board;
+};
+
+struct MazeGame {
+    GameState state;
+};
+
+MazeBoard* maze_board_from_files(const char* directory, unsigned int seed, FILE* diagnostics) {
+    MazeBoard* handle = malloc(sizeof(MazeBoard));
+    if (handle == NULL) return NULL;
+    
+    if (!maze_initialize_board(&handle->board, seed, diagnostics)) {
+        free(handle);
+        return NULL;
+    }
+    handle->board.out = diagnostics;
+    if (!maze_load_board_files(&handle->board, directory)) {
+        maze_free_board(&handle->board);
+        free(handle);
+        return NULL;
+    }
+    handle->board.out = NULL;
+    handle->board.errors = NULL;
+    return handle;
+}
+
+MazeBoard* maze_board_from_file(const char* filename) {
+    MazeBoard* handle = malloc(sizeof(MazeBoard));
+    if (handle == NULL) return NULL;
+    
+    if (!maze_initialize_board_from_file(&handle->board, filename, NULL)) {
+        free(handle);
+        return NULL;
+    }
+    return handle;
+}
+
+MazeBoard* maze_board_from_memory(const void* data, size_t size) {
+    MazeBoard* handle = malloc(sizeof(MazeBoard));
+    if (handle == NULL) return NULL;
+    
+    if (!initialize_board_from_memory(&handle->board, data, size, "Board image", NULL)) {
+        free(handle);
+        return NULL;
+    }
+    return handle;
+}
+
+void maze_board_free(MazeBoard* board) {
+    if (board == NULL) return;
+    maze_free_board(&board->board);
+    free(board);
+}
+
+MazeGame* maze_game_create(const MazeBoard* board, unsigned int seed) {
+    MazeGame* game = malloc(sizeof(MazeGame));
+    if (game == NULL) return NULL;
+    
+    maze_start_game(&game->state, &board->board, seed);
+    maze_game_set_sink(game, NULL, NULL, MAZE_LOG_OFF);
+    return game;
+}
+
+void maze_game_reset(MazeGame* game, unsigned int seed) {
+    MazeEventSink sink = game->state.sink;
+    void* context = game->state.sink_context;
+    int level = game->state.log_level;
+    
+    maze_start_game(&game->state, game->state.board, seed);
+    maze_game_set_sink(game, sink, context, level);
+}
+
+void maze_game_free(MazeGame* game) {
+    free(game);
+}
+
+void maze_game_set_sink(MazeGame* game, MazeEventSink sink, void* context, int level) {
+    game->state.sink = sink;
+    game->state.sink_context = context;
+    game->state.log_level = sink != NULL ? level : MAZE_LOG_OFF;
+}
+
+bool maze_game_step_turn(MazeGame* game) {
+    if (!game->state.game_over) {
+        maze_play_next_turn(&game->state);
+    }
+    return !game->state.game_over;
+}
+
+bool maze_game_step_round(MazeGame* game) {
+    do {
+        maze_game_step_turn(game);
+    } while (!game->state.game_over && game->state.next_player != 0);
+    return !game->state.game_over;
+}
+
+char maze_game_play(MazeGame* game) {
+    maze_play_game(&game->state);
+    return game->state.winner;
+}
+
+bool maze_game_over(const MazeGame* game) {
+    return game->state.game_over;
+}
+
+char maze_game_winner(const MazeGame* game) {
+    return game->state.winner;
+}
+
+int maze_game_round(const MazeGame* game) {
+    return game->state.round_count;
+}
+
+int maze_game_next_player(const MazeGame* game) {
+    return game->state.next_player;
+}
+
+bool maze_game_player(const MazeGame* game, int index, MazePlayer* player) {
+    if (index < 0 || index >= MAX_PLAYERS) return false;
+    
+    const Player* p = &game->state.players[index];
+    player->name = p->name;
+    player->floor = p->floor;
+    player->width = p->width;
+    player->length = p->length;
+    player->direction = p->direction;
+    player->movement_points = p->movement_points;
+    player->dice_throw_count = p->dice_throw_count;
+    player->in_maze = p->in_maze;
+    player->in_bawana = p->in_bawana;
+    player->triggered = p->triggered;
+    player->food_poisoning_turns = p->food_poisoning_turns;
+    player->disoriented_turns = p->disoriented_turns;
+    return true;
+}
+
+void maze_game_snapshot(const MazeGame* game, MazeSnapshot* snapshot) {
+    GameSnapshot state;
+    game_snapshot(&game->state, &state);
+    memset(snapshot, 0, sizeof(*snapshot));
+    memcpy(snapshot, &state, sizeof(state));
+}
+
+bool maze_game_restore(MazeGame* game, const MazeSnapshot* snapshot) {
+    GameSnapshot state;
+    memcpy(&state, snapshot, sizeof(state));
+    return game_restore(&game->state, &state);
+}
+
+MazeGame* maze_game_fork(const MazeGame* parent, uint64_t branch) {
+    MazeGame* child = malloc(sizeof(MazeGame));
+    if (child == NULL) return NULL;
+    
+    game_fork(&child->state, &parent->state, branch);
+    maze_game_set_sink(child, NULL, NULL, MAZE_LOG_OFF);
+    return child;
+}
+
+void maze_render_event(FILE* out, const MazeEvent* event) {
+    render_event(out, event);
+}
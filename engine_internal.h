@@ -0,0 +1,363 @@
+#ifndef ENGINE_INTERNAL_H
+#define ENGINE_INTERNAL_H
+
+// The engine's own types and functions, shared by engine.c and the
+// maze_game tools built on it. None of this is libmaze's interface: the
+// functions are hidden in libmaze.so, and carry a maze_ prefix so that
+// libmaze.a cannot clash with an embedding program's names.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "maze_game.h"
+
+// Highest narration level compiled into the engine. Building with
+// -DMAZE_LOG_LEVEL=MAZE_LOG_OFF (or a lower level) removes the event code for
+// the levels above it; GameState.log_level then selects among what is left.
+#ifndef MAZE_LOG_LEVEL
+#define MAZE_LOG_LEVEL MAZE_LOG_STEP
+#endif
+
+#define LOG_ENABLED(game, level) ((level) <= MAZE_LOG_LEVEL && (level) <= (game)->log_level)
+
+// Hot-path instrumentation. -DMAZE_STATS=1 counts events into
+// GameState.stats, -DMAZE_STATS=2 also times maze_play_turn and
+// maze_move_player_with_effects (in TSC cycles on x86, nanoseconds elsewhere).
+// At 0, the default, the counters, timers and the stats field are gone.
+#ifndef MAZE_STATS
+#define MAZE_STATS 0
+#endif
+
+// Board dimensions are read at run time; the cap keeps every coordinate
+// inside the int8 fields of MazeEvent.
+#define MAX_DIMENSION 127
+#define MAX_STAIRS 1024
+#define CLASSIC_FLOORS 3
+#define CLASSIC_WIDTH 10
+#define CLASSIC_LENGTH 25
+#define MAX_PLAYERS MAZE_PLAYERS
+// Defaults for a board's Rules. The caps also bound what Rules may set:
+// the solver packs movement points into 11 bits and the round within the
+// stair cycle into 3.
+#define INITIAL_MOVEMENT_POINTS 100
+#define MAX_MOVEMENT_POINTS 1000  
+#define BAWANA_CELLS 16
+// Turns a Bawana food poisoning or disorientation lasts.
+#define FOOD_POISONING_TURNS 3
+#define DISORIENTED_TURNS 4
+#define STAIR_DIRECTION_CHANGE_ROUNDS 5
+#define STAIR_FLIP_LIMIT 8
+#define STRINGIFY(value) STRINGIFY_TEXT(value)
+#define STRINGIFY_TEXT(value) #value
+#define STATIC_ASSERT(condition, name) typedef char static_assert_##name[(condition) ? 1 : -1]
+#define CELL_KINDS 5
+#define NUM_DIRECTIONS 4
+#define NO_CELL -1
+#define NO_TRANSITION 0
+#define NO_OFFSET SIZE_MAX
+#define UNREACHABLE -1
+#define STAIR_UP(game, stair) (((game)->stairs_up[(stair) / 64] >> ((stair) % 64)) & 1)
+#define CELL_INDEX(board, floor, width, length) ((((floor) * (board)->maze_width + (width)) * (board)->maze_length) + (length))
+#define RNG_STREAM_BOARD 0
+#define RNG_STREAM_PLAY 1
+#define RNG_STREAM_GENERATE 2
+#define CACHE_LINE 64
+
+typedef enum {
+    EMPTY = 1,
+    NORTH = 2,
+    EAST = 3,
+    SOUTH = 4,
+    WEST = 5
+} Direction;
+
+typedef enum {
+    EFFECT_NONE = 0,
+    EFFECT_CONSUMABLE,
+    EFFECT_BONUS_ADD,
+    EFFECT_BONUS_MULTIPLY
+} CellEffectType;
+
+typedef enum {
+    BAWANA_FOOD_POISONING = 0,
+    BAWANA_DISORIENTED,
+    BAWANA_TRIGGERED,
+    BAWANA_HAPPY,
+    BAWANA_RANDOM_POINTS
+} BawanaEffect;
+
+// A cell packs into one byte: the low nibble is its effect code, an index
+// into cell_effects, and the bits above hold its BawanaEffect.
+typedef uint8_t Cell;
+
+#define CELL_EFFECT_MASK 0x0F
+#define CELL_BAWANA_SHIFT 4
+#define CELL_CONSUMABLE(points) (points)
+#define CELL_BONUS_ADD(points) (4 + (points))
+#define CELL_BONUS_MULTIPLY(factor) (8 + (factor))
+#define NUM_CELL_EFFECTS 12
+#define MAKE_CELL(effect, bawana) ((Cell)((effect) | ((bawana) << CELL_BAWANA_SHIFT)))
+#define CELL_EFFECT(cell) ((cell) & CELL_EFFECT_MASK)
+#define CELL_BAWANA(cell) ((BawanaEffect)((cell) >> CELL_BAWANA_SHIFT))
+
+// The fixed cells on floor 0 that play puts players on; engine.c describes
+// them where it defines them.
+extern const int maze_player_home[MAX_PLAYERS][3];
+extern const int maze_player_entry[MAX_PLAYERS][2];
+extern const int maze_bawana_exit[2];
+
+// Philox4x32-10 counter-based generator. Draw n of a stream is a pure function
+// of (key, stream, n), so jumping ahead or splitting off a stream is O(1).
+typedef struct {
+    uint32_t key[2];
+    uint64_t stream;
+    uint64_t position;
+    uint64_t cached_block;
+    uint32_t block[4];
+} Rng;
+
+typedef struct {
+    char name;
+    int floor;
+    int width;
+    int length;
+    Direction direction;
+    bool in_maze;
+    int dice_throw_count;
+    int movement_points;
+    
+    int food_poisoning_turns;
+    int disoriented_turns;
+    bool triggered;
+    bool in_bawana;
+    Direction random_direction;
+} Player;
+
+typedef struct {
+    int start_floor, start_width, start_length;
+    int end_floor, end_width, end_length;
+} Stair;
+
+typedef struct {
+    int start_floor, end_floor;
+    int width, length;
+} Pole;
+
+typedef struct {
+    int floor;
+    int start_width, start_length;
+    int end_width, end_length;
+} Wall;
+
+// Per-board storage is carved from one block, so a board stays contiguous
+// and is released in one go. For a compiled board the block is the file
+// mapping itself.
+typedef struct {
+    uint8_t* base;
+    size_t used;
+    size_t capacity;
+    void* mapping;
+    size_t mapping_size;
+} Arena;
+
+// Every array a Board carves from its arena, with its element count.
+#define BOARD_ARRAYS(X) \
+    X(floor_plan, board->num_cells) \
+    X(maze, board->num_cells) \
+    X(stairs, board->num_stairs) \
+    X(poles, board->num_poles) \
+    X(walls, board->num_walls) \
+    X(neighbours, board->num_cells) \
+    X(stair_end_head, board->num_cells) \
+    X(stair_end_next, board->num_stairs * 2) \
+    X(first_pole, board->num_cells) \
+    X(plain_run, board->num_cells) \
+    X(ray_cost, board->num_cells * NUM_DIRECTIONS) \
+    X(ray_bonus, board->num_cells * NUM_DIRECTIONS) \
+    X(flag_distance, board->num_cells)
+
+typedef enum {
+#define BOARD_ARRAY_ID(name, count) BOARD_ARRAY_##name,
+    BOARD_ARRAYS(BOARD_ARRAY_ID)
+#undef BOARD_ARRAY_ID
+    BOARD_ARRAY_COUNT
+} BoardArrayId;
+
+// Everything fixed for a run of games: the layout, the cells rolled for
+// seed and the tables derived from them. Games only read it, so any number
+// of them, on any threads, can share one Board.
+#define BAWANA_EFFECTS (BAWANA_RANDOM_POINTS + 1)
+
+// The rule constants a board is played under. cell_mix gives the percent
+// of cells that roll each kind, in initialize_maze_cells order (free,
+// consumable 1-4, bonus 1-2, bonus 3-5, multiplier); bawana_mix the number
+// of Bawana cells with each BawanaEffect. Fixed-size fields only, so Rules
+// go into a compiled board as they are.
+typedef struct {
+    int32_t initial_points;
+    int32_t max_points;
+    int32_t stair_flip_rounds;
+    int32_t cell_mix[CELL_KINDS];
+    int32_t bawana_mix[BAWANA_EFFECTS];
+} Rules;
+
+typedef struct {
+    // Cells are numbered CELL_INDEX(board, floor, width, length);
+    // floor_plan[cell] is 1 where the floor exists.
+    int num_floors, maze_width, maze_length, num_cells;
+    uint8_t* floor_plan;
+    Cell* maze;
+    Stair* stairs;
+    Pole* poles;
+    Wall* walls;
+    // neighbours[cell][dir - NORTH] is the cell one step away, or NO_CELL
+    // when a boundary, an inaccessible cell or a wall is in the way.
+    int32_t (*neighbours)[NUM_DIRECTIONS];
+    // stair_end_head/stair_end_next list the stair ends on each cell in file
+    // order (end e = 2 * stair + is_top); first_pole is the first pole that
+    // slides from each cell. A player landing on a cell takes the first
+    // listed stair whose direction leads away from that end, else the pole.
+    int32_t* stair_end_head;
+    int32_t* stair_end_next;
+    int32_t* first_pole;
+    // plain_run[cell][dir - NORTH] counts the open steps from cell before the
+    // next blocked step or event cell (stair end, pole, multiplier, flag or
+    // Bawana). ray_cost/ray_bonus[(dir - NORTH) * num_cells + cell] hold
+    // running sums of consumable and bonus-add values along each line in
+    // travel order, so the sums over any stretch of a run are a single
+    // subtraction.
+    int8_t (*plain_run)[NUM_DIRECTIONS];
+    int16_t* ray_cost;
+    int16_t* ray_bonus;
+    // flag_distance[cell] is the fewest steps from standing on cell to the
+    // flag, or UNREACHABLE. Stairs count both ways, since flips make either
+    // direction possible, and poles only down; dice and facing are ignored.
+    int32_t* flag_distance;
+    Arena arena;
+    int num_stairs, num_poles, num_walls;
+    int flag_floor, flag_width, flag_length;
+    unsigned int seed;
+    Rules rules;
+    // Loader messages go to out and errors, that stop a load or that say
+    // the board ran out of memory, to errors; either may be NULL.
+    FILE* out;
+    FILE* errors;
+} Board;
+
+#define GAME_STATS(X) \
+    X(games) X(turns) X(entry_rolls) X(steps) X(wall_checks) X(blocked_moves) \
+    X(wall_bumps) X(stairs_used) X(poles_used) X(captures) X(bawana_transports) \
+    X(mp_cap_hits) X(turn_timed) X(turn_time) X(move_timed) X(move_time)
+
+// Counters from a MAZE_STATS build, for one game or summed over many.
+// blocked_moves counts every move a wall stopped; wall_bumps only those
+// that stopped on the first step and cost 2 MP.
+typedef struct {
+#define STAT_FIELD(name) uint64_t name;
+    GAME_STATS(STAT_FIELD)
+#undef STAT_FIELD
+    uint64_t bawana_visits[BAWANA_EFFECTS];
+} GameStats;
+
+// One game on a shared Board: a few hundred bytes that change as it plays.
+// stairs_up holds one bit per stair, set while it leads up.
+typedef struct {
+    const Board* board;
+    Player players[MAX_PLAYERS];
+    uint64_t stairs_up[MAX_STAIRS / 64];
+    bool game_over;
+    char winner;
+    int round_count;
+    int next_player;
+    unsigned int seed;
+    Rng rng;
+    int log_level;
+    MazeEventSink sink;
+    void* sink_context;
+    struct DrawScript* script;
+    struct DiceTape* tape;
+#if MAZE_STATS
+    GameStats stats;
+#endif
+} GameState;
+
+// Flag bits of a player's state packed into one byte, as snapshots and
+// the solver's state keys store it.
+#define PLAYER_IN_MAZE 1
+#define PLAYER_TRIGGERED 2
+#define PLAYER_IN_BAWANA 4
+
+// Outcomes chosen for a game's draws instead of rolling them. The first
+// length draws replay values[]; any later draw takes 0 and records its
+// bound, so advancing values[] like an odometer visits every outcome of a
+// turn exactly once.
+typedef struct DrawScript {
+    uint32_t* values;
+    uint32_t* bounds;
+    int capacity;
+    int length;
+    int used;
+    bool overflow;
+} DrawScript;
+
+#define TAPE_TURN 0
+
+// A tape is every draw a game made, in order, as (bound, value) records.
+// After each turn comes a record with bound TAPE_TURN whose value is a
+// hash of the play state, so a replay can tell the first turn at which
+// an engine stopped doing what the recording engine did.
+typedef struct {
+    uint32_t bound;
+    uint32_t value;
+} TapeRecord;
+
+typedef struct DiceTape {
+    TapeRecord* records;
+    size_t length;
+    size_t capacity;
+    size_t position;
+    bool replay;
+    bool diverged;
+    uint64_t turns;
+    uint32_t seed;
+    uint64_t board_hash;
+    // Where a replay reports the turn it diverged at, or NULL.
+    FILE* out;
+} DiceTape;
+
+void maze_rules_default(Rules* rules);
+const char* maze_rules_check(const Rules* rules);
+const char* maze_rules_set(Rules* rules, const char* assignment);
+bool maze_initialize_board(Board* board, unsigned int seed, FILE* errors);
+void maze_roll_board(Board* board, unsigned int seed);
+void maze_start_game(GameState* game, const Board* board, unsigned int seed);
+void maze_free_board(Board* board);
+bool maze_clone_board(Board* copy, const Board* board);
+void* maze_board_alloc(Board* board, size_t size);
+bool maze_load_floor_plan_from_file(Board* board, const char* filename);
+bool maze_load_board_files(Board* board, const char* directory);
+unsigned int maze_load_seed_from_file(const char* filename, FILE* out);
+bool maze_save_board_file(const Board* board, const char* filename);
+bool maze_initialize_board_from_file(Board* board, const char* filename, FILE* errors);
+void maze_rng_seed(Rng* rng, uint64_t seed, uint64_t stream);
+int maze_rng_uniform(Rng* rng, uint32_t bound);
+void maze_rng_jump(Rng* rng, uint64_t draws);
+bool maze_is_floor_accessible(const Board* board, int floor, int width, int length);
+bool maze_is_in_bawana(int width, int length);
+bool maze_is_path_blocked_by_wall(const Board* board, int floor, int start_w, int start_l, int end_w, int end_l);
+void maze_build_adjacency_table(Board* board);
+void maze_build_transition_index(Board* board);
+bool maze_build_distance_field(Board* board);
+void maze_move_player_with_effects(GameState* game, Player* player, Direction dir, int steps);
+void maze_apply_cell_effects(GameState* game, Player* player, int floor, int width, int length, int* cost);
+bool maze_check_and_use_stairs_poles(GameState* game, Player* player);
+void maze_change_stair_directions(GameState* game);
+void maze_play_turn(GameState* game, int player_index);
+void maze_play_next_turn(GameState* game);
+void maze_play_game(GameState* game);
+uint64_t maze_board_fingerprint(const Board* board);
+void maze_tape_start(DiceTape* tape, const GameState* game);
+
+#endif
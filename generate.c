@@ -0,0 +1,329 @@
+// --generate: random stairs, poles, walls and flag on the board.txt floor
+// plan, written out as compiled boards.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "engine_internal.h"
+#include "tools.h"
+
+#define GENERATE_ATTEMPTS 1000
+#define MAX_WALL_LENGTH 5
+
+typedef struct {
+    const Board* template;
+    const GeneratorConfig* config;
+    const char* out_dir;
+    unsigned int first_seed;
+    int num_boards;
+    int next_board;
+    long long rejected;
+    int failed;
+    pthread_mutex_t lock;
+} GenerateJob;
+
+static void* generate_worker(void* arg);
+
+// Turns densities (per accessible cell) into counts for boards shaped like
+// template and lists the cells placements may use.
+bool generator_setup(GeneratorConfig* config, const Board* template, double stair_density, double pole_density, double wall_density) {
+    int accessible = 0;
+    config->num_open = 0;
+    config->open_cells = malloc(template->num_cells * sizeof(int32_t));
+    if (config->open_cells == NULL) return false;
+    
+    for (int cell = 0; cell < template->num_cells; cell++) {
+        if (!template->floor_plan[cell]) continue;
+        accessible++;
+        
+        int floor = cell / (template->maze_width * template->maze_length);
+        int width = (cell / template->maze_length) % template->maze_width;
+        int length = cell % template->maze_length;
+        bool reserved = floor == 0 && (maze_is_in_bawana(width, length) ||
+                                       (width == maze_bawana_exit[0] && length == maze_bawana_exit[1]));
+        
+        for (int i = 0; i < MAX_PLAYERS && floor == 0; i++) {
+            reserved |= (width == maze_player_home[i][0] && length == maze_player_home[i][1]) ||
+                        (width == maze_player_entry[i][0] && length == maze_player_entry[i][1]);
+        }
+        if (!reserved) {
+            config->open_cells[config->num_open++] = cell;
+        }
+    }
+    
+    config->num_stairs = (int)(stair_density * accessible + 0.5);
+    config->num_poles = (int)(pole_density * accessible + 0.5);
+    config->num_walls = (int)(wall_density * accessible + 0.5);
+    if (config->num_stairs > MAX_STAIRS) config->num_stairs = MAX_STAIRS;
+    return true;
+}
+
+// Readies board to take generated layouts: a copy of template with room
+// for the configured stairs, poles and walls, so generating never
+// allocates.
+bool generator_board(Board* board, const Board* template, const GeneratorConfig* config) {
+    if (!maze_clone_board(board, template)) return false;
+    board->out = NULL;
+    board->stairs = maze_board_alloc(board, config->num_stairs * sizeof(Stair));
+    board->stair_end_next = maze_board_alloc(board, config->num_stairs * 2 * sizeof(int32_t));
+    board->poles = maze_board_alloc(board, config->num_poles * sizeof(Pole));
+    board->walls = maze_board_alloc(board, config->num_walls * sizeof(Wall));
+    if (board->stairs == NULL || board->stair_end_next == NULL || board->poles == NULL || board->walls == NULL) {
+        maze_free_board(board);
+        return false;
+    }
+    return true;
+}
+
+// Lays out stairs, poles, walls and a flag on a board from generator_board,
+// from seed's generation stream, then rolls its cells from seed. Layouts in
+// which some player's entry cannot reach the flag are drawn again;
+// rejected counts them. Returns false if every attempt failed or memory
+// ran out.
+bool generate_board(Board* board, unsigned int seed, const GeneratorConfig* config, int* rejected) {
+    Rng rng;
+    maze_rng_seed(&rng, seed, RNG_STREAM_GENERATE);
+    int floor_size = board->maze_width * board->maze_length;
+    *rejected = 0;
+    
+    for (int attempt = 0; attempt < GENERATE_ATTEMPTS; attempt++) {
+        board->num_stairs = 0;
+        board->num_poles = 0;
+        board->num_walls = 0;
+        
+        // Stairs join two floors; the lower end is the start.
+        for (int tries = 0; board->num_stairs < config->num_stairs && tries < GENERATE_ATTEMPTS; tries++) {
+            int a = config->open_cells[maze_rng_uniform(&rng, config->num_open)];
+            int b = config->open_cells[maze_rng_uniform(&rng, config->num_open)];
+            if (a / floor_size == b / floor_size) continue;
+            if (a > b) {
+                int swap = a;
+                a = b;
+                b = swap;
+            }
+            
+            Stair* stair = &board->stairs[board->num_stairs++];
+            stair->start_floor = a / floor_size;
+            stair->start_width = (a / board->maze_length) % board->maze_width;
+            stair->start_length = a % board->maze_length;
+            stair->end_floor = b / floor_size;
+            stair->end_width = (b / board->maze_length) % board->maze_width;
+            stair->end_length = b % board->maze_length;
+        }
+        
+        // Poles drop from an upper floor to an open cell straight below.
+        for (int tries = 0; board->num_poles < config->num_poles && tries < GENERATE_ATTEMPTS; tries++) {
+            int top = config->open_cells[maze_rng_uniform(&rng, config->num_open)];
+            int floor = top / floor_size;
+            if (floor == 0) continue;
+            
+            int end_floor = maze_rng_uniform(&rng, floor);
+            int bottom = top - (floor - end_floor) * floor_size;
+            if (!board->floor_plan[bottom] ||
+                (end_floor == 0 && !maze_is_floor_accessible(board, 0, (bottom / board->maze_length) % board->maze_width, bottom % board->maze_length))) {
+                continue;
+            }
+            
+            Pole* pole = &board->poles[board->num_poles++];
+            pole->start_floor = floor;
+            pole->end_floor = end_floor;
+            pole->width = (top / board->maze_length) % board->maze_width;
+            pole->length = top % board->maze_length;
+        }
+        
+        // Walls run straight from an open cell for up to MAX_WALL_LENGTH cells.
+        for (int tries = 0; board->num_walls < config->num_walls && tries < GENERATE_ATTEMPTS; tries++) {
+            int start = config->open_cells[maze_rng_uniform(&rng, config->num_open)];
+            int width = (start / board->maze_length) % board->maze_width;
+            int length = start % board->maze_length;
+            int extent = maze_rng_uniform(&rng, MAX_WALL_LENGTH) + 1;
+            bool along_width = maze_rng_uniform(&rng, 2) == 0;
+            int end_width = along_width ? width + extent : width;
+            int end_length = along_width ? length : length + extent;
+            if (end_width >= board->maze_width || end_length >= board->maze_length) continue;
+            
+            Wall* wall = &board->walls[board->num_walls++];
+            wall->floor = start / floor_size;
+            wall->start_width = width;
+            wall->start_length = length;
+            wall->end_width = end_width;
+            wall->end_length = end_length;
+        }
+        
+        int flag = config->open_cells[maze_rng_uniform(&rng, config->num_open)];
+        board->flag_floor = flag / floor_size;
+        board->flag_width = (flag / board->maze_length) % board->maze_width;
+        board->flag_length = flag % board->maze_length;
+        
+        maze_build_adjacency_table(board);
+        maze_build_transition_index(board);
+        if (!maze_build_distance_field(board)) return false;
+        
+        bool valid = true;
+        for (int i = 0; i < MAX_PLAYERS; i++) {
+            valid &= board->flag_distance[CELL_INDEX(board, 0, maze_player_entry[i][0], maze_player_entry[i][1])] != UNREACHABLE;
+        }
+        
+        if (valid) {
+            maze_roll_board(board, seed);
+            return true;
+        }
+        (*rejected)++;
+    }
+    return false;
+}
+
+static void* generate_worker(void* arg) {
+    GenerateJob* job = (GenerateJob*)arg;
+    Board board;
+    long long rejected = 0;
+    int failed = 0;
+    char filename[4096];
+    
+    if (!generator_board(&board, job->template, job->config)) {
+        fprintf(stderr, "Error: Out of memory for a worker board\n");
+        return NULL;
+    }
+    
+    while (true) {
+        pthread_mutex_lock(&job->lock);
+        int index = job->next_board++;
+        pthread_mutex_unlock(&job->lock);
+        
+        if (index >= job->num_boards) break;
+        
+        unsigned int seed = job->first_seed + (unsigned int)index;
+        int attempts_rejected;
+        bool ok = generate_board(&board, seed, job->config, &attempts_rejected);
+        rejected += attempts_rejected;
+        
+        if (!ok) {
+            fprintf(stderr, "Warning: No valid board for seed %u in %d attempts\n", seed, GENERATE_ATTEMPTS);
+            failed++;
+            continue;
+        }
+        
+        if (job->out_dir != NULL) {
+            snprintf(filename, sizeof(filename), "%s/board-%u.mzb", job->out_dir, seed);
+            if (!maze_save_board_file(&board, filename)) {
+                fprintf(stderr, "Error: Cannot write %s\n", filename);
+                failed++;
+            }
+        }
+    }
+    
+    pthread_mutex_lock(&job->lock);
+    job->rejected += rejected;
+    job->failed += failed;
+    pthread_mutex_unlock(&job->lock);
+    
+    maze_free_board(&board);
+    return NULL;
+}
+
+int generate_main(int argc, char* argv[]) {
+    const char* out_dir = NULL;
+    double density[3] = {0.005, 0.03, 0.01};
+    int num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    bool usage = argc < 4;
+    
+    for (int i = 4; i < argc && !usage; i++) {
+        if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out_dir = argv[++i];
+        } else if (strcmp(argv[i], "--density") == 0 && i + 1 < argc) {
+            usage = sscanf(argv[++i], "%lf,%lf,%lf", &density[0], &density[1], &density[2]) != 3 ||
+                    density[0] < 0 || density[1] < 0 || density[2] < 0;
+        } else if (i == 4 && argv[i][0] != '-') {
+            num_threads = atoi(argv[i]);
+        } else {
+            usage = true;
+        }
+    }
+    
+    if (usage) {
+        fprintf(stderr, "Usage: %s --generate FIRST_SEED COUNT [THREADS] [--density STAIRS,POLES,WALLS] [--out DIR]\n", argv[0]);
+        return 1;
+    }
+    
+    GenerateJob job;
+    job.first_seed = (unsigned int)strtoul(argv[2], NULL, 10);
+    job.num_boards = atoi(argv[3]);
+    job.next_board = 0;
+    job.out_dir = out_dir;
+    job.rejected = 0;
+    job.failed = 0;
+    if (job.num_boards <= 0) {
+        fprintf(stderr, "Error: Board count must be positive\n");
+        return 1;
+    }
+    if (num_threads < 1) num_threads = 1;
+    
+    Board template;
+    if (!maze_initialize_board(&template, 0, stderr)) return 1;
+    template.out = stderr;
+    if (!maze_load_floor_plan_from_file(&template, "board.txt")) {
+        maze_free_board(&template);
+        return 1;
+    }
+    
+    GeneratorConfig config;
+    if (!generator_setup(&config, &template, density[0], density[1], density[2])) {
+        fprintf(stderr, "Error: Out of memory for the generator\n");
+        maze_free_board(&template);
+        return 1;
+    }
+    job.template = &template;
+    job.config = &config;
+    
+    pthread_t* threads = malloc(num_threads * sizeof(pthread_t));
+    if (threads == NULL) {
+        fprintf(stderr, "Error: Out of memory for %d threads\n", num_threads);
+        free(config.open_cells);
+        maze_free_board(&template);
+        return 1;
+    }
+    pthread_mutex_init(&job.lock, NULL);
+    
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    int started = 0;
+    for (int t = 0; t < num_threads; t++) {
+        if (pthread_create(&threads[t], NULL, generate_worker, &job) != 0) {
+            fprintf(stderr, "Warning: Could only start %d of %d threads\n", started, num_threads);
+            break;
+        }
+        started++;
+    }
+    
+    if (started == 0) {
+        generate_worker(&job);
+    }
+    
+    for (int t = 0; t < started; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    
+    fprintf(stderr, "Generated %d boards (%d stairs, %d poles, %d walls each) on %d threads in %.3f s "
+            "(%.1f boards/sec); %lld layouts rejected, %d seeds failed\n",
+            job.num_boards - job.failed, config.num_stairs, config.num_poles, config.num_walls,
+            started > 0 ? started : 1, elapsed, elapsed > 0 ? job.num_boards / elapsed : 0.0,
+            job.rejected, job.failed);
+    
+    pthread_mutex_destroy(&job.lock);
+    free(threads);
+    free(config.open_cells);
+    maze_free_board(&template);
+    return job.failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,163 @@
+#ifndef MAZE_GAME_H
+#define MAZE_GAME_H
+
+// Embedding interface to the maze engine, built into libmaze.a and
+// libmaze.so by the Makefile. The engine keeps no global state: a
+// MazeBoard is read-only once created and any number of games, on any
+// threads, may play on it at once; a MazeGame is used by one thread at a
+// time.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#if defined(__GNUC__)
+#define MAZE_API __attribute__((visibility("default")))
+#else
+#define MAZE_API
+#endif
+
+#define MAZE_PLAYERS 3
+
+// Narration levels, from nothing to every step.
+#define MAZE_LOG_OFF 0
+#define MAZE_LOG_SUMMARY 1
+#define MAZE_LOG_TURN 2
+#define MAZE_LOG_STEP 3
+
+typedef enum {
+    MAZE_EVENT_TURN_START = 1,
+    MAZE_EVENT_STAIR_FLIP,
+    MAZE_EVENT_STATE_BEGIN,
+    MAZE_EVENT_PLAYER_STATUS,
+    MAZE_EVENT_STATE_END,
+    MAZE_EVENT_GAME_WON,
+    MAZE_EVENT_FLAG_CAPTURE,
+    MAZE_EVENT_ENTRY_ROLL,
+    MAZE_EVENT_MOVE_ROLL,
+    MAZE_EVENT_DIRECTION_ROLL,
+    MAZE_EVENT_TRIGGERED_ROLL,
+    MAZE_EVENT_DISORIENTED_ROLL,
+    MAZE_EVENT_DISORIENT_RECOVERED,
+    MAZE_EVENT_BLOCKED,
+    MAZE_EVENT_WALL_BUMP,
+    MAZE_EVENT_MOVE_SUMMARY,
+    MAZE_EVENT_POSITION,
+    MAZE_EVENT_STAIR,
+    MAZE_EVENT_POLE,
+    MAZE_EVENT_CAPTURE,
+    MAZE_EVENT_BAWANA_TRANSPORT,
+    MAZE_EVENT_BAWANA_EFFECT,
+    MAZE_EVENT_POISON_SKIP,
+    MAZE_EVENT_POISON_RECOVERED
+} MazeEventType;
+
+#define MAZE_STATUS_IN_MAZE 1
+#define MAZE_STATUS_TRIGGERED 2
+#define MAZE_STATUS_IN_BAWANA 4
+
+// One fixed-size record per narrated happening. floor/width/length is the
+// player's position unless noted; the other fields depend on the type:
+//   TURN_START, STAIR_FLIP, STATE_BEGIN  value = round
+//   PLAYER_STATUS   direction, count = MAZE_STATUS_* bits, to_floor = poisoned
+//                   turns, to_width = disoriented turns, amount = movement
+//                   points, value = dice throws
+//   STATE_END, FLAG_CAPTURE             position = flag
+//   ENTRY_ROLL, MOVE_ROLL, TRIGGERED_ROLL, DISORIENTED_ROLL, BLOCKED
+//                   amount = movement roll, direction = direction moved
+//   DIRECTION_ROLL  as above, count = direction dice result
+//   MOVE_SUMMARY    count = cells moved, amount = cost, value = movement
+//                   points left, direction = facing
+//   STAIR, POLE     position = cell landed on, to_* = destination
+//   CAPTURE         count = name of the captured player
+//   BAWANA_EFFECT   count = BawanaEffect, amount = random points bonus
+typedef struct {
+    uint8_t type;
+    char player;
+    int8_t direction;
+    int8_t count;
+    int8_t floor, width, length;
+    int8_t to_floor, to_width, to_length;
+    int16_t amount;
+    int32_t value;
+} MazeEvent;
+
+typedef void (*MazeEventSink)(void* context, const MazeEvent* event);
+
+typedef struct MazeBoard MazeBoard;
+typedef struct MazeGame MazeGame;
+
+// One player's state. direction (like MazeEvent.direction) is 2 for
+// north, 3 east, 4 south and 5 west.
+typedef struct {
+    char name;
+    int floor, width, length;
+    int direction;
+    int movement_points;
+    int dice_throw_count;
+    bool in_maze;
+    bool in_bawana;
+    bool triggered;
+    int food_poisoning_turns;
+    int disoriented_turns;
+} MazePlayer;
+
+// Loads board.txt, stairs.txt, poles.txt, walls.txt and flag.txt from
+// directory (NULL for the current one) and rolls the cells from seed.
+// Loader messages go to diagnostics, which may be NULL. Returns NULL if
+// board.txt cannot be used, the flag cannot be reached or memory runs out.
+MAZE_API MazeBoard* maze_board_from_files(const char* directory, unsigned int seed, FILE* diagnostics);
+
+// Opens a board written by --compile-board, or copies one held in memory
+// at an 8-byte aligned address. Both are silent and return NULL for a
+// board that cannot be used.
+MAZE_API MazeBoard* maze_board_from_file(const char* filename);
+MAZE_API MazeBoard* maze_board_from_memory(const void* data, size_t size);
+MAZE_API void maze_board_free(MazeBoard* board);
+
+// A silent game on board, which must outlive it, with dice from seed.
+// maze_game_reset starts it over with a new seed without allocating and
+// keeps its sink.
+MAZE_API MazeGame* maze_game_create(const MazeBoard* board, unsigned int seed);
+MAZE_API void maze_game_reset(MazeGame* game, unsigned int seed);
+MAZE_API void maze_game_free(MazeGame* game);
+
+// Sends the game's events up to level to sink, on the calling thread. A
+// NULL sink silences the game.
+MAZE_API void maze_game_set_sink(MazeGame* game, MazeEventSink sink, void* context, int level);
+
+// Play the next player's turn, the rest of the current round, or the rest
+// of the game. The step functions return false once the game is over;
+// maze_game_play returns the winner's name, or 0 if nobody won.
+MAZE_API bool maze_game_step_turn(MazeGame* game);
+MAZE_API bool maze_game_step_round(MazeGame* game);
+MAZE_API char maze_game_play(MazeGame* game);
+
+MAZE_API bool maze_game_over(const MazeGame* game);
+MAZE_API char maze_game_winner(const MazeGame* game);
+MAZE_API int maze_game_round(const MazeGame* game);
+MAZE_API int maze_game_next_player(const MazeGame* game);
+MAZE_API bool maze_game_player(const MazeGame* game, int index, MazePlayer* player);
+
+// A game's whole play state (players, stair directions, round, next
+// player and dice position) as plain data, which may be copied or stored
+// as is. It can only be restored on the board it was taken from.
+typedef struct {
+    uint64_t data[32];
+} MazeSnapshot;
+
+// maze_game_restore puts game back in the state snapshot holds, keeping
+// its board and sink; it returns false, leaving game as it was, for a
+// snapshot taken on another board or with any field out of range for this
+// one. maze_game_fork returns a silent copy of parent:
+// branch 0 replays the parent's dice, any other branch gives the copy dice
+// of its own.
+MAZE_API void maze_game_snapshot(const MazeGame* game, MazeSnapshot* snapshot);
+MAZE_API bool maze_game_restore(MazeGame* game, const MazeSnapshot* snapshot);
+MAZE_API MazeGame* maze_game_fork(const MazeGame* parent, uint64_t branch);
+
+// Writes the narration for event, as the game binary prints it.
+MAZE_API void maze_render_event(FILE* out, const MazeEvent* event);
+
+#endif
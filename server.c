@@ -0,0 +1,889 @@
+// --serve: games hosted for clients over a socket, on one event loop per
+// thread, and --serve-load, a client that measures it.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "engine_internal.h"
+#include "tools.h"
+
+#ifndef EPOLLEXCLUSIVE
+#define EPOLLEXCLUSIVE (1u << 28)
+#endif
+
+#define SERVER_SESSIONS 65536
+#define SERVER_CONNECTIONS 1024
+#define SERVER_IN_BUFFER 4096
+#define SERVER_OUT_BUFFER 65536
+#define SERVER_EVENTS 256
+#define SERVER_LISTENER UINT32_MAX
+#define SERVER_WAKE (UINT32_MAX - 1)
+#define SERVER_SLOT_BITS 20
+#define NO_SLOT -1
+
+// The most a single turn can write to a watching connection. A connection
+// only plays another turn while this much of its output buffer is free, so
+// events are never dropped; a slow reader just holds up its own games.
+#define SERVER_TURN_RESERVE 16384
+
+typedef enum {
+    WORK_NONE,
+    WORK_TURNS,
+    WORK_ROUNDS,
+    WORK_PLAY
+} ServerWork;
+
+// A game hosted by the server. Sessions belong to the connection that
+// made them, are listed on it through prev/next_owned, and end with it.
+// Ids carry a generation so a freed id never reaches the slot's next game.
+typedef struct {
+    GameState game;
+    struct ServerLoop* loop;
+    uint32_t generation;
+    int owner;
+    int prev_owned, next_owned;
+    int next_free;
+} ServerSession;
+
+// One client. Input is parsed a line at a time; a command that plays
+// turns becomes pending work, carried on as output space allows. A reply
+// that does not fit the output buffer sets overflowed, and the connection
+// is closed rather than sent a cut line.
+typedef struct {
+    int fd;
+    int in_length;
+    int out_length, out_sent;
+    bool want_write;
+    bool overflowed;
+    int first_session;
+    int next_free;
+    int work_session;
+    ServerWork work;
+    int work_count;
+    char in[SERVER_IN_BUFFER];
+    char out[SERVER_OUT_BUFFER];
+} ServerConnection;
+
+// One event loop, run by one thread on its own sessions and connections;
+// nothing in it is shared, so nothing in it is locked.
+typedef struct ServerLoop {
+    int index;
+    int epoll_fd;
+    int listen_fd;
+    int wake_fd;
+    const Board* board;
+    ServerSession* sessions;
+    int num_sessions;
+    int free_session;
+    int live_sessions;
+    ServerConnection* connections;
+    int num_connections;
+    int free_connection;
+    uint64_t commands;
+    uint64_t turns;
+} ServerLoop;
+
+typedef struct {
+    const char* address;
+    int index;
+    int sessions;
+    int rounds;
+    uint64_t turns;
+    uint64_t* histogram;
+    bool failed;
+} LoadClient;
+
+#define LOAD_BUCKETS 100000
+
+static int server_listen(const char* address, bool* is_unix);
+static int server_connect(const char* address);
+static bool server_loop_init(ServerLoop* loop, int index, const Board* board, int listen_fd, int wake_fd, int sessions, int connections);
+static void server_loop_free(ServerLoop* loop);
+static void* server_loop_run(void* arg);
+static void server_accept(ServerLoop* loop);
+static void server_read(ServerLoop* loop, int slot);
+static void server_flush(ServerLoop* loop, int slot);
+static void server_close(ServerLoop* loop, int slot);
+static void server_command(ServerLoop* loop, int slot, char* line);
+static void server_work(ServerLoop* loop, int slot);
+static void server_event_sink(void* context, const MazeEvent* event);
+static void* load_client_run(void* arg);
+
+// Addresses are a Unix socket path (anything with a '/') or a TCP
+// [HOST:]PORT, the host defaulting to 127.0.0.1.
+static bool split_address(const char* address, char* host, size_t host_size, const char** port) {
+    const char* colon = strrchr(address, ':');
+    if (colon == NULL) {
+        snprintf(host, host_size, "127.0.0.1");
+        *port = address;
+        return true;
+    }
+    if ((size_t)(colon - address) >= host_size) return false;
+    memcpy(host, address, colon - address);
+    host[colon - address] = '\0';
+    *port = colon + 1;
+    return true;
+}
+
+static int open_socket(const char* address, bool listening) {
+    if (strchr(address, '/') != NULL) {
+        struct sockaddr_un name;
+        memset(&name, 0, sizeof(name));
+        name.sun_family = AF_UNIX;
+        if (strlen(address) >= sizeof(name.sun_path)) return -1;
+        strcpy(name.sun_path, address);
+        
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        if (listening) unlink(address);
+        
+        int result = listening ? bind(fd, (struct sockaddr*)&name, sizeof(name)) :
+                                 connect(fd, (struct sockaddr*)&name, sizeof(name));
+        if (result != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+    
+    char host[256];
+    const char* port;
+    struct addrinfo hints, *found;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = listening ? AI_PASSIVE : 0;
+    if (!split_address(address, host, sizeof(host), &port) || getaddrinfo(host, port, &hints, &found) != 0) {
+        return -1;
+    }
+    
+    int fd = -1;
+    for (struct addrinfo* info = found; info != NULL && fd < 0; info = info->ai_next) {
+        fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+        if (fd < 0) continue;
+        
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        if ((listening ? bind(fd, info->ai_addr, info->ai_addrlen) : connect(fd, info->ai_addr, info->ai_addrlen)) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(found);
+    return fd;
+}
+
+static int server_listen(const char* address, bool* is_unix) {
+    *is_unix = strchr(address, '/') != NULL;
+    int fd = open_socket(address, true);
+    if (fd < 0 || listen(fd, SOMAXCONN) != 0 || fcntl(fd, F_SETFL, O_NONBLOCK) != 0) {
+        fprintf(stderr, "Error: Cannot listen on %s: %s\n", address, strerror(errno));
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int server_connect(const char* address) {
+    int fd = open_socket(address, false);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Cannot connect to %s: %s\n", address, strerror(errno));
+    }
+    return fd;
+}
+
+static bool server_loop_init(ServerLoop* loop, int index, const Board* board, int listen_fd, int wake_fd, int sessions, int connections) {
+    memset(loop, 0, sizeof(*loop));
+    loop->index = index;
+    loop->board = board;
+    loop->listen_fd = listen_fd;
+    loop->wake_fd = wake_fd;
+    loop->num_sessions = sessions;
+    loop->num_connections = connections;
+    
+    // calloc leaves untouched slots as untouched pages, so a large pool
+    // costs memory only as it fills.
+    loop->sessions = calloc(sessions, sizeof(ServerSession));
+    loop->connections = calloc(connections, sizeof(ServerConnection));
+    loop->epoll_fd = epoll_create1(0);
+    if (loop->sessions == NULL || loop->connections == NULL || loop->epoll_fd < 0) {
+        server_loop_free(loop);
+        return false;
+    }
+    
+    for (int i = 0; i < sessions; i++) {
+        loop->sessions[i].loop = loop;
+        loop->sessions[i].owner = NO_SLOT;
+        loop->sessions[i].next_free = i + 1 < sessions ? i + 1 : NO_SLOT;
+    }
+    for (int i = 0; i < connections; i++) {
+        loop->connections[i].fd = -1;
+        loop->connections[i].next_free = i + 1 < connections ? i + 1 : NO_SLOT;
+    }
+    loop->free_session = sessions > 0 ? 0 : NO_SLOT;
+    loop->free_connection = connections > 0 ? 0 : NO_SLOT;
+    
+    struct epoll_event listener = {EPOLLIN | EPOLLEXCLUSIVE, {.u32 = SERVER_LISTENER}};
+    struct epoll_event wake = {EPOLLIN, {.u32 = SERVER_WAKE}};
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, listen_fd, &listener) != 0 ||
+        epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, wake_fd, &wake) != 0) {
+        server_loop_free(loop);
+        return false;
+    }
+    return true;
+}
+
+static void server_loop_free(ServerLoop* loop) {
+    for (int i = 0; loop->connections != NULL && i < loop->num_connections; i++) {
+        if (loop->connections[i].fd >= 0) close(loop->connections[i].fd);
+    }
+    if (loop->epoll_fd >= 0) close(loop->epoll_fd);
+    free(loop->sessions);
+    free(loop->connections);
+    loop->sessions = NULL;
+    loop->connections = NULL;
+    loop->epoll_fd = -1;
+}
+
+// Appends one whole reply line, or marks the connection overflowed.
+static void server_printf(ServerConnection* connection, const char* format, ...) {
+    int space = SERVER_OUT_BUFFER - connection->out_length;
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(connection->out + connection->out_length, space, format, args);
+    va_end(args);
+    if (written >= 0 && written < space) {
+        connection->out_length += written;
+    } else {
+        connection->overflowed = true;
+    }
+}
+
+static void server_interest(ServerLoop* loop, int slot, bool want_write) {
+    ServerConnection* connection = &loop->connections[slot];
+    if (connection->want_write == want_write) return;
+    
+    struct epoll_event interest = {want_write ? EPOLLOUT : EPOLLIN, {.u32 = (uint32_t)slot}};
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, connection->fd, &interest);
+    connection->want_write = want_write;
+}
+
+static uint32_t session_id(const ServerLoop* loop, int slot) {
+    return (uint32_t)slot | (loop->sessions[slot].generation << SERVER_SLOT_BITS);
+}
+
+// Finds a session of connection by id, or returns NO_SLOT.
+static int session_find(const ServerLoop* loop, int connection, unsigned long id) {
+    int slot = (int)(id & ((1u << SERVER_SLOT_BITS) - 1));
+    if (id > UINT32_MAX || slot >= loop->num_sessions) return NO_SLOT;
+    
+    const ServerSession* session = &loop->sessions[slot];
+    if (session->owner != connection || session->generation != (uint32_t)(id >> SERVER_SLOT_BITS)) return NO_SLOT;
+    return slot;
+}
+
+static void session_release(ServerLoop* loop, int slot) {
+    ServerSession* session = &loop->sessions[slot];
+    ServerConnection* owner = &loop->connections[session->owner];
+    
+    if (session->prev_owned != NO_SLOT) {
+        loop->sessions[session->prev_owned].next_owned = session->next_owned;
+    } else {
+        owner->first_session = session->next_owned;
+    }
+    if (session->next_owned != NO_SLOT) {
+        loop->sessions[session->next_owned].prev_owned = session->prev_owned;
+    }
+    
+    session->owner = NO_SLOT;
+    session->next_free = loop->free_session;
+    loop->free_session = slot;
+    loop->live_sessions--;
+}
+
+static void server_accept(ServerLoop* loop) {
+    while (true) {
+        int fd = accept(loop->listen_fd, NULL, NULL);
+        if (fd < 0) return;
+        
+        int slot = loop->free_connection;
+        if (slot == NO_SLOT || fcntl(fd, F_SETFL, O_NONBLOCK) != 0) {
+            close(fd);
+            continue;
+        }
+        
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        
+        ServerConnection* connection = &loop->connections[slot];
+        struct epoll_event interest = {EPOLLIN, {.u32 = (uint32_t)slot}};
+        if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &interest) != 0) {
+            close(fd);
+            continue;
+        }
+        
+        loop->free_connection = connection->next_free;
+        connection->fd = fd;
+        connection->in_length = 0;
+        connection->out_length = 0;
+        connection->out_sent = 0;
+        connection->want_write = false;
+        connection->overflowed = false;
+        connection->first_session = NO_SLOT;
+        connection->work = WORK_NONE;
+    }
+}
+
+static void server_close(ServerLoop* loop, int slot) {
+    ServerConnection* connection = &loop->connections[slot];
+    while (connection->first_session != NO_SLOT) {
+        session_release(loop, connection->first_session);
+    }
+    
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, connection->fd, NULL);
+    close(connection->fd);
+    connection->fd = -1;
+    connection->next_free = loop->free_connection;
+    loop->free_connection = slot;
+}
+
+// Sends what output is buffered. Returns true once all of it has gone;
+// otherwise the connection waits for the socket to take more.
+static bool server_send(ServerLoop* loop, int slot) {
+    ServerConnection* connection = &loop->connections[slot];
+    
+    while (connection->out_sent < connection->out_length) {
+        ssize_t sent = send(connection->fd, connection->out + connection->out_sent,
+                            connection->out_length - connection->out_sent, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                server_interest(loop, slot, true);
+            } else {
+                server_close(loop, slot);
+            }
+            return false;
+        }
+        connection->out_sent += (int)sent;
+    }
+    
+    connection->out_length = 0;
+    connection->out_sent = 0;
+    server_interest(loop, slot, false);
+    return true;
+}
+
+static void server_reply_state(ServerLoop* loop, ServerConnection* connection, int slot) {
+    const GameState* game = &loop->sessions[slot].game;
+    server_printf(connection, "OK %u %d %d %d %c\n", session_id(loop, slot), game->round_count,
+                  game->next_player, game->game_over ? 1 : 0, game->winner ? game->winner : '-');
+}
+
+static void server_work(ServerLoop* loop, int slot) {
+    ServerConnection* connection = &loop->connections[slot];
+    ServerSession* session = &loop->sessions[connection->work_session];
+    
+    while (connection->work != WORK_NONE && !session->game.game_over) {
+        if (SERVER_OUT_BUFFER - connection->out_length < SERVER_TURN_RESERVE) return;
+        
+        maze_play_next_turn(&session->game);
+        loop->turns++;
+        
+        if (connection->work == WORK_TURNS ||
+            (connection->work == WORK_ROUNDS && session->game.next_player == 0)) {
+            if (--connection->work_count <= 0) connection->work = WORK_NONE;
+        }
+    }
+    
+    connection->work = WORK_NONE;
+    server_reply_state(loop, connection, connection->work_session);
+}
+
+static void server_event_sink(void* context, const MazeEvent* event) {
+    ServerSession* session = (ServerSession*)context;
+    ServerLoop* loop = session->loop;
+    server_printf(&loop->connections[session->owner], "EV %u %d %c %d %d %d %d %d %d %d %d %d %d\n",
+                  session_id(loop, (int)(session - loop->sessions)), event->type, event->player ? event->player : '-',
+                  event->direction, event->count, event->floor, event->width, event->length,
+                  event->to_floor, event->to_width, event->to_length, event->amount, event->value);
+}
+
+static void server_command(ServerLoop* loop, int slot, char* line) {
+    ServerConnection* connection = &loop->connections[slot];
+    char command[16];
+    unsigned long first = 0, second = 1;
+    int fields = sscanf(line, "%15s %lu %lu", command, &first, &second);
+    loop->commands++;
+    
+    if (fields < 1) return;
+    
+    if (strcmp(command, "NEW") == 0) {
+        int found = loop->free_session;
+        if (found == NO_SLOT) {
+            server_printf(connection, "ERR all %d sessions are in use\n", loop->num_sessions);
+            return;
+        }
+        
+        ServerSession* session = &loop->sessions[found];
+        loop->free_session = session->next_free;
+        loop->live_sessions++;
+        session->generation = (session->generation + 1) & ((1u << (32 - SERVER_SLOT_BITS)) - 1);
+        session->owner = slot;
+        session->prev_owned = NO_SLOT;
+        session->next_owned = connection->first_session;
+        if (connection->first_session != NO_SLOT) {
+            loop->sessions[connection->first_session].prev_owned = found;
+        }
+        connection->first_session = found;
+        
+        maze_start_game(&session->game, loop->board, (unsigned int)first);
+        session->game.log_level = MAZE_LOG_OFF;
+        session->game.sink = server_event_sink;
+        session->game.sink_context = session;
+        server_printf(connection, "OK %u\n", session_id(loop, found));
+        return;
+    }
+    
+    if (strcmp(command, "STATS") == 0) {
+        server_printf(connection, "OK %d %d %d %llu %llu\n", loop->index, loop->live_sessions, loop->num_sessions,
+                      (unsigned long long)loop->commands, (unsigned long long)loop->turns);
+        return;
+    }
+    
+    static const char* const session_commands[] = {"TURN", "ROUND", "PLAY", "STATE", "WATCH", "FREE"};
+    bool known = false;
+    for (size_t i = 0; i < sizeof(session_commands) / sizeof(session_commands[0]); i++) {
+        known = known || strcmp(command, session_commands[i]) == 0;
+    }
+    if (!known) {
+        server_printf(connection, "ERR unknown command %s\n", command);
+        return;
+    }
+    
+    int found = fields >= 2 ? session_find(loop, slot, first) : NO_SLOT;
+    if (found == NO_SLOT) {
+        server_printf(connection, "ERR no session %s\n", fields >= 2 ? "with that id" : "given");
+        return;
+    }
+    ServerSession* session = &loop->sessions[found];
+    
+    if (strcmp(command, "TURN") == 0 || strcmp(command, "ROUND") == 0 || strcmp(command, "PLAY") == 0) {
+        if (fields >= 3 && (second < 1 || second > INT_MAX)) {
+            server_printf(connection, "ERR count must be from 1 to %d\n", INT_MAX);
+            return;
+        }
+        connection->work = command[0] == 'T' ? WORK_TURNS : command[0] == 'R' ? WORK_ROUNDS : WORK_PLAY;
+        connection->work_count = fields >= 3 ? (int)second : 1;
+        connection->work_session = found;
+        server_work(loop, slot);
+    } else if (strcmp(command, "STATE") == 0) {
+        // Built whole first, so the reply goes out as one line or not at all.
+        const GameState* game = &session->game;
+        char reply[512];
+        int length = snprintf(reply, sizeof(reply), "OK %u %d %d %d %c", session_id(loop, found), game->round_count,
+                              game->next_player, game->game_over ? 1 : 0, game->winner ? game->winner : '-');
+        for (int i = 0; i < MAX_PLAYERS; i++) {
+            const Player* player = &game->players[i];
+            length += snprintf(reply + length, sizeof(reply) - length, " %c %d %d %d %d %d", player->name,
+                               player->floor, player->width, player->length, player->direction,
+                               player->movement_points);
+        }
+        server_printf(connection, "%s\n", reply);
+    } else if (strcmp(command, "WATCH") == 0) {
+        if (fields >= 3 && second > MAZE_LOG_STEP) {
+            server_printf(connection, "ERR level must be from %d to %d\n", MAZE_LOG_OFF, MAZE_LOG_STEP);
+            return;
+        }
+        int level = fields >= 3 ? (int)second : MAZE_LOG_STEP;
+        session->game.log_level = level > MAZE_LOG_LEVEL ? MAZE_LOG_LEVEL : level;
+        server_printf(connection, "OK %u\n", session_id(loop, found));
+    } else {
+        server_printf(connection, "OK %u\n", session_id(loop, found));
+        session_release(loop, found);
+    }
+}
+
+// Runs pending work and then buffered commands until one has to wait for
+// more input or for output space.
+static void server_process(ServerLoop* loop, int slot) {
+    ServerConnection* connection = &loop->connections[slot];
+    
+    while (connection->fd >= 0) {
+        int start = 0;
+        while (true) {
+            if (connection->work != WORK_NONE) {
+                server_work(loop, slot);
+                if (connection->work != WORK_NONE) break;
+            }
+            if (SERVER_OUT_BUFFER - connection->out_length < SERVER_TURN_RESERVE) break;
+            
+            char* end = memchr(connection->in + start, '\n', connection->in_length - start);
+            if (end == NULL) break;
+            
+            *end = '\0';
+            if (end > connection->in + start && end[-1] == '\r') end[-1] = '\0';
+            server_command(loop, slot, connection->in + start);
+            start = (int)(end + 1 - connection->in);
+        }
+        
+        if (connection->overflowed) {
+            server_close(loop, slot);
+            return;
+        }
+        
+        memmove(connection->in, connection->in + start, connection->in_length - start);
+        connection->in_length -= start;
+        
+        if (connection->in_length == SERVER_IN_BUFFER) {
+            server_close(loop, slot);
+            return;
+        }
+        if (!server_send(loop, slot)) return;
+        if (connection->work == WORK_NONE && memchr(connection->in, '\n', connection->in_length) == NULL) return;
+    }
+}
+
+static void server_read(ServerLoop* loop, int slot) {
+    ServerConnection* connection = &loop->connections[slot];
+    ssize_t got = recv(connection->fd, connection->in + connection->in_length,
+                       SERVER_IN_BUFFER - connection->in_length, 0);
+    
+    if (got == 0 || (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        server_close(loop, slot);
+        return;
+    }
+    if (got > 0) {
+        connection->in_length += (int)got;
+        server_process(loop, slot);
+    }
+}
+
+static void server_flush(ServerLoop* loop, int slot) {
+    if (server_send(loop, slot)) {
+        server_process(loop, slot);
+    }
+}
+
+static void* server_loop_run(void* arg) {
+    ServerLoop* loop = (ServerLoop*)arg;
+    struct epoll_event events[SERVER_EVENTS];
+    bool running = true;
+    
+    while (running) {
+        int count = epoll_wait(loop->epoll_fd, events, SERVER_EVENTS, -1);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "Error: Event loop %d failed: %s\n", loop->index, strerror(errno));
+            break;
+        }
+        
+        for (int i = 0; i < count; i++) {
+            uint32_t slot = events[i].data.u32;
+            if (slot == SERVER_WAKE) {
+                running = false;
+            } else if (slot == SERVER_LISTENER) {
+                server_accept(loop);
+            } else if (loop->connections[slot].fd >= 0) {
+                if (events[i].events & EPOLLOUT) {
+                    server_flush(loop, (int)slot);
+                } else if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    server_read(loop, (int)slot);
+                }
+            }
+        }
+    }
+    return NULL;
+}
+
+int server_main(int argc, char* argv[]) {
+    const char* board_name = NULL;
+    int num_loops = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int sessions = SERVER_SESSIONS;
+    int connections = SERVER_CONNECTIONS;
+    bool usage = argc < 3;
+    
+    for (int i = 3; i < argc && !usage; i++) {
+        if (strcmp(argv[i], "--board") == 0 && i + 1 < argc) {
+            board_name = argv[++i];
+        } else if (strcmp(argv[i], "--sessions") == 0 && i + 1 < argc) {
+            sessions = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--connections") == 0 && i + 1 < argc) {
+            connections = atoi(argv[++i]);
+        } else if (i == 3 && argv[i][0] != '-') {
+            num_loops = atoi(argv[i]);
+        } else {
+            usage = true;
+        }
+    }
+    
+    if (usage) {
+        fprintf(stderr, "Usage: %s --serve SOCKET_PATH|[HOST:]PORT [LOOPS] [--sessions N] [--connections N] "
+                "[--board FILE.mzb]\n", argv[0]);
+        return 1;
+    }
+    if (num_loops < 1) num_loops = 1;
+    if (sessions < num_loops) sessions = num_loops;
+    if (connections < num_loops) connections = num_loops;
+    if (sessions / num_loops > (1 << SERVER_SLOT_BITS)) {
+        fprintf(stderr, "Error: At most %d sessions per loop\n", 1 << SERVER_SLOT_BITS);
+        return 1;
+    }
+    
+    Board board;
+    if (board_name != NULL) {
+        if (!maze_initialize_board_from_file(&board, board_name, stderr)) return 1;
+    } else {
+        if (!maze_initialize_board(&board, maze_load_seed_from_file("seed.txt", stderr), stderr)) return 1;
+        board.out = stderr;
+        if (!maze_load_board_files(&board, NULL)) {
+            maze_free_board(&board);
+            return 1;
+        }
+    }
+    board.out = NULL;
+    
+    // Stop signals are taken by sigwait below; the loops never see them.
+    sigset_t stop;
+    sigemptyset(&stop);
+    sigaddset(&stop, SIGINT);
+    sigaddset(&stop, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop, NULL);
+    
+    bool is_unix;
+    int wake[2];
+    int listen_fd = server_listen(argv[2], &is_unix);
+    ServerLoop* loops = calloc(num_loops, sizeof(ServerLoop));
+    pthread_t* threads = malloc(num_loops * sizeof(pthread_t));
+    if (listen_fd < 0 || loops == NULL || threads == NULL || pipe(wake) != 0) {
+        if (listen_fd >= 0) fprintf(stderr, "Error: Cannot set up %d event loops\n", num_loops);
+        if (listen_fd >= 0) close(listen_fd);
+        free(loops);
+        free(threads);
+        maze_free_board(&board);
+        return 1;
+    }
+    
+    int started = 0;
+    for (int i = 0; i < num_loops; i++) {
+        if (!server_loop_init(&loops[i], i, &board, listen_fd, wake[0], sessions / num_loops, connections / num_loops)) {
+            fprintf(stderr, "Error: Cannot set up event loop %d\n", i);
+            break;
+        }
+        if (pthread_create(&threads[i], NULL, server_loop_run, &loops[i]) != 0) {
+            server_loop_free(&loops[i]);
+            fprintf(stderr, "Warning: Could only start %d of %d event loops\n", started, num_loops);
+            break;
+        }
+        started++;
+    }
+    
+    if (started > 0) {
+        fprintf(stderr, "Serving on %s: %d event loops, %d sessions, %d connections\n", argv[2], started,
+                started * (sessions / num_loops), started * (connections / num_loops));
+        int signal_number;
+        sigwait(&stop, &signal_number);
+    }
+    
+    if (write(wake[1], "x", 1) != 1) {
+        fprintf(stderr, "Warning: Cannot wake the event loops\n");
+    }
+    
+    uint64_t commands = 0, turns = 0;
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+        commands += loops[i].commands;
+        turns += loops[i].turns;
+        server_loop_free(&loops[i]);
+    }
+    fprintf(stderr, "Served %llu commands and %llu turns\n", (unsigned long long)commands, (unsigned long long)turns);
+    
+    close(wake[0]);
+    close(wake[1]);
+    close(listen_fd);
+    if (is_unix) unlink(argv[2]);
+    free(loops);
+    free(threads);
+    maze_free_board(&board);
+    return started > 0 ? 0 : 1;
+}
+
+// Reads one reply line into line, keeping any bytes after it in buffer.
+static bool load_read_line(int fd, char* buffer, int* length, char* line, int size) {
+    while (true) {
+        char* end = memchr(buffer, '\n', *length);
+        if (end != NULL) {
+            int used = (int)(end + 1 - buffer);
+            int copy = used < size ? used : size;
+            memcpy(line, buffer, copy - 1);
+            line[copy - 1] = '\0';
+            memmove(buffer, buffer + used, *length - used);
+            *length -= used;
+            return true;
+        }
+        
+        ssize_t got = recv(fd, buffer + *length, SERVER_IN_BUFFER - *length, 0);
+        if (got <= 0) return false;
+        *length += (int)got;
+    }
+}
+
+static bool load_request(int fd, char* buffer, int* length, char* reply, const char* format, ...) {
+    char request[64];
+    va_list args;
+    va_start(args, format);
+    int size = vsnprintf(request, sizeof(request), format, args);
+    va_end(args);
+    
+    return send(fd, request, size, MSG_NOSIGNAL) == size &&
+           load_read_line(fd, buffer, length, reply, 256) && strncmp(reply, "OK ", 3) == 0;
+}
+
+// One client connection: creates its sessions, then plays them a turn at
+// a time, timing each request, and swaps finished games for new ones.
+static void* load_client_run(void* arg) {
+    LoadClient* client = (LoadClient*)arg;
+    char buffer[SERVER_IN_BUFFER];
+    char reply[256];
+    int length = 0;
+    unsigned int seed = (unsigned int)client->index * (unsigned int)client->sessions * 1000u + 1;
+    
+    int fd = server_connect(client->address);
+    unsigned long* ids = malloc(client->sessions * sizeof(unsigned long));
+    if (fd < 0 || ids == NULL) {
+        client->failed = true;
+        if (fd >= 0) close(fd);
+        free(ids);
+        return NULL;
+    }
+    
+    for (int i = 0; i < client->sessions && !client->failed; i++) {
+        client->failed = !load_request(fd, buffer, &length, reply, "NEW %u\n", seed++) ||
+                         sscanf(reply, "OK %lu", &ids[i]) != 1;
+    }
+    
+    for (int turn = 0; turn < client->rounds * MAX_PLAYERS && !client->failed; turn++) {
+        for (int i = 0; i < client->sessions && !client->failed; i++) {
+            struct timespec start, end;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            client->failed = !load_request(fd, buffer, &length, reply, "TURN %lu\n", ids[i]);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            
+            long micros = (end.tv_sec - start.tv_sec) * 1000000L + (end.tv_nsec - start.tv_nsec) / 1000;
+            client->histogram[micros < LOAD_BUCKETS ? micros : LOAD_BUCKETS - 1]++;
+            client->turns++;
+            
+            unsigned long id;
+            int round, next, over;
+            if (!client->failed && sscanf(reply, "OK %lu %d %d %d", &id, &round, &next, &over) == 4 && over) {
+                client->failed = !load_request(fd, buffer, &length, reply, "FREE %lu\n", ids[i]) ||
+                                 !load_request(fd, buffer, &length, reply, "NEW %u\n", seed++) ||
+                                 sscanf(reply, "OK %lu", &ids[i]) != 1;
+            }
+        }
+    }
+    
+    close(fd);
+    free(ids);
+    return NULL;
+}
+
+static long load_percentile(const uint64_t* histogram, uint64_t total, double fraction) {
+    uint64_t wanted = (uint64_t)(total * fraction);
+    uint64_t seen = 0;
+    for (long micros = 0; micros < LOAD_BUCKETS; micros++) {
+        seen += histogram[micros];
+        if (seen > wanted) return micros;
+    }
+    return LOAD_BUCKETS;
+}
+
+int load_main(int argc, char* argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s --serve-load SOCKET_PATH|[HOST:]PORT [CONNECTIONS] [SESSIONS] [ROUNDS]\n", argv[0]);
+        return 1;
+    }
+    
+    int num_clients = argc > 3 ? atoi(argv[3]) : 4;
+    int sessions = argc > 4 ? atoi(argv[4]) : 1000;
+    int rounds = argc > 5 ? atoi(argv[5]) : 10;
+    if (num_clients < 1 || sessions < 1 || rounds < 1) {
+        fprintf(stderr, "Error: Connections, sessions and rounds must be positive\n");
+        return 1;
+    }
+    
+    LoadClient* clients = calloc(num_clients, sizeof(LoadClient));
+    pthread_t* threads = malloc(num_clients * sizeof(pthread_t));
+    uint64_t* histogram = calloc(LOAD_BUCKETS, sizeof(uint64_t));
+    if (clients == NULL || threads == NULL || histogram == NULL) {
+        fprintf(stderr, "Error: Out of memory for %d clients\n", num_clients);
+        free(clients);
+        free(threads);
+        free(histogram);
+        return 1;
+    }
+    
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    int started = 0;
+    for (int i = 0; i < num_clients; i++) {
+        clients[i].address = argv[2];
+        clients[i].index = i;
+        clients[i].sessions = sessions;
+        clients[i].rounds = rounds;
+        clients[i].histogram = calloc(LOAD_BUCKETS, sizeof(uint64_t));
+        if (clients[i].histogram == NULL || pthread_create(&threads[i], NULL, load_client_run, &clients[i]) != 0) {
+            free(clients[i].histogram);
+            fprintf(stderr, "Warning: Could only start %d of %d clients\n", started, num_clients);
+            break;
+        }
+        started++;
+    }
+    
+    uint64_t turns = 0;
+    int failed = 0;
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+        for (int b = 0; b < LOAD_BUCKETS; b++) {
+            histogram[b] += clients[i].histogram[b];
+        }
+        turns += clients[i].turns;
+        failed += clients[i].failed;
+        free(clients[i].histogram);
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    
+    printf("Stepped %llu turns over %d connections x %d sessions in %.3f s (%.1f turns/sec)\n",
+           (unsigned long long)turns, started, sessions, elapsed, elapsed > 0 ? turns / elapsed : 0.0);
+    printf("Step latency: p50 %ld us, p99 %ld us, p99.9 %ld us\n", load_percentile(histogram, turns, 0.5),
+           load_percentile(histogram, turns, 0.99), load_percentile(histogram, turns, 0.999));
+    if (failed > 0) {
+        fprintf(stderr, "Error: %d of %d clients failed\n", failed, started);
+    }
+    
+    free(clients);
+    free(threads);
+    free(histogram);
+    return failed > 0 || started == 0 ? 1 : 0;
+}
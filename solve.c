@@ -0,0 +1,741 @@
+// --solve: the exact odds of a board, from its game as a Markov chain.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "engine_internal.h"
+#include "tools.h"
+
+#define MARKOV_DEFAULT_MAX_STATES (1 << 20)
+#define MARKOV_MAX_ITERATIONS 1000000
+#define MARKOV_TOLERANCE 1e-12
+#define MARKOV_PLAYER_BITS 45
+#define MARKOV_LOST MAX_PLAYERS
+#define MARKOV_ROUNDS (MAX_PLAYERS + 1)
+#define MARKOV_VALUES (MAX_PLAYERS + 2)
+#define MARKOV_FULL -1
+#define MARKOV_NO_MEMORY -2
+
+// A board's game as an absorbing Markov chain. A state is the game just
+// before one player's turn, packed into key_words words. States are
+// explored busiest first, up to max_states; a transition to a state
+// past that limit goes to the lost column instead, so the solution tells
+// how much probability the limit cost. Column -(k + 1) means player k has
+// captured the flag and -(MARKOV_LOST + 1) that the game was lost.
+typedef struct {
+    const Board* board;
+    int key_words;
+    int64_t num_states;
+    int64_t max_states;
+    int64_t state_capacity;
+    uint64_t* keys;
+    uint8_t* starts_round;
+    // Row s is row_length[s] transitions from row_start[s], laid out in
+    // the order states are expanded; row_length is -1 until then.
+    int64_t* row_start;
+    int32_t* row_length;
+    // Probability flowing into each state from the states expanded so far,
+    // a running estimate of how often games pass through it.
+    double* weights;
+    // Open-addressed index of keys: state id + 1, or 0 for an empty slot.
+    int32_t* slots;
+    int64_t slot_mask;
+    int32_t* columns;
+    double* probabilities;
+    int64_t num_transitions;
+    int64_t transition_capacity;
+} MarkovChain;
+
+typedef struct {
+    double weight;
+    int32_t state;
+} MarkovEntry;
+
+// Jacobi iteration for every player's win probability and the expected
+// rounds, with the rows split between threads that meet at a barrier after
+// each sweep.
+typedef struct {
+    const MarkovChain* chain;
+    double* values[2];
+    double* thread_change;
+    int num_threads;
+    int iterations;
+    double change;
+    bool done;
+    bool ready;
+    pthread_barrier_t barrier;
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+} MarkovSolve;
+
+typedef struct {
+    MarkovSolve* solve;
+    int index;
+} MarkovWorker;
+
+static bool script_next(DrawScript* script);
+static bool markov_encode(const MarkovChain* chain, const GameState* game, int turn, uint64_t* key);
+static int markov_decode(const MarkovChain* chain, const uint64_t* key, GameState* game);
+static int64_t markov_find_state(MarkovChain* chain, const uint64_t* key);
+static bool markov_build(MarkovChain* chain, const Board* board, int64_t max_states);
+static void markov_free(MarkovChain* chain);
+static void* markov_worker(void* arg);
+static bool markov_solve(const MarkovChain* chain, int num_threads, MarkovSolve* solve);
+
+// Moves on to the next combination of draws; false once every outcome of
+// the turn has been visited.
+static bool script_next(DrawScript* script) {
+    for (int i = script->used - 1; i >= 0; i--) {
+        if (script->values[i] + 1 < script->bounds[i]) {
+            script->values[i]++;
+            script->length = i + 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void put_bits(uint64_t* key, int* offset, uint64_t value, int bits) {
+    int word = *offset / 64, shift = *offset % 64;
+    key[word] |= value << shift;
+    if (shift + bits > 64) {
+        key[word + 1] |= value >> (64 - shift);
+    }
+    *offset += bits;
+}
+
+static uint64_t get_bits(const uint64_t* key, int* offset, int bits) {
+    int word = *offset / 64, shift = *offset % 64;
+    uint64_t value = key[word] >> shift;
+    if (shift + bits > 64) {
+        value |= key[word + 1] << (64 - shift);
+    }
+    *offset += bits;
+    return value & ((1ull << bits) - 1);
+}
+
+// Packs the state before player turn's move: the turn, the round modulo the
+// stair flip period, every player (MARKOV_PLAYER_BITS each) and one bit per
+// stair. Whatever the rules never read is left out, so equivalent games
+// share a key: dice throws count modulo 4, a player outside the maze and
+// the Bawana has no position or throw count, and without stairs the round
+// does not matter. Returns false for a value that does not fit its field.
+static bool markov_encode(const MarkovChain* chain, const GameState* game, int turn, uint64_t* key) {
+    const Board* board = chain->board;
+    int offset = 0;
+    memset(key, 0, chain->key_words * sizeof(uint64_t));
+    put_bits(key, &offset, (uint64_t)turn, 2);
+    put_bits(key, &offset, board->num_stairs > 0 ? (uint64_t)(game->round_count % board->rules.stair_flip_rounds) : 0, 3);
+    
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        const Player* player = &game->players[i];
+        bool waiting = !player->in_maze && !player->in_bawana;
+        
+        if (player->movement_points < -1024 || player->movement_points > 1023 ||
+            player->food_poisoning_turns < 0 || player->food_poisoning_turns > 3 ||
+            player->disoriented_turns < 0 || player->disoriented_turns > 7) {
+            return false;
+        }
+        
+        int cell = waiting ? CELL_INDEX(board, 0, maze_player_home[i][0], maze_player_home[i][1]) :
+                             CELL_INDEX(board, player->floor, player->width, player->length);
+        put_bits(key, &offset, (uint64_t)cell, 21);
+        put_bits(key, &offset, (uint64_t)player->direction, 3);
+        put_bits(key, &offset, (uint64_t)(player->movement_points + 1024), 11);
+        put_bits(key, &offset, waiting ? 0 : (uint64_t)(player->dice_throw_count & 3), 2);
+        put_bits(key, &offset, (uint64_t)player->food_poisoning_turns, 2);
+        put_bits(key, &offset, (uint64_t)player->disoriented_turns, 3);
+        put_bits(key, &offset, (uint64_t)((player->in_maze ? PLAYER_IN_MAZE : 0) |
+                                          (player->triggered ? PLAYER_TRIGGERED : 0) |
+                                          (player->in_bawana ? PLAYER_IN_BAWANA : 0)), 3);
+    }
+    
+    for (int i = 0; i < board->num_stairs; i++) {
+        put_bits(key, &offset, STAIR_UP(game, i), 1);
+    }
+    return true;
+}
+
+// Unpacks key into game, which must already be started on the chain's
+// board, and returns whose turn it is.
+static int markov_decode(const MarkovChain* chain, const uint64_t* key, GameState* game) {
+    const Board* board = chain->board;
+    int offset = 0;
+    int turn = (int)get_bits(key, &offset, 2);
+    game->round_count = (int)get_bits(key, &offset, 3);
+    game->game_over = false;
+    game->winner = '\0';
+    
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        Player* player = &game->players[i];
+        int cell = (int)get_bits(key, &offset, 21);
+        
+        player->length = cell % board->maze_length;
+        player->width = cell / board->maze_length % board->maze_width;
+        player->floor = cell / board->maze_length / board->maze_width;
+        player->direction = (Direction)get_bits(key, &offset, 3);
+        player->movement_points = (int)get_bits(key, &offset, 11) - 1024;
+        player->dice_throw_count = (int)get_bits(key, &offset, 2);
+        player->food_poisoning_turns = (int)get_bits(key, &offset, 2);
+        player->disoriented_turns = (int)get_bits(key, &offset, 3);
+        
+        int flags = (int)get_bits(key, &offset, 3);
+        player->in_maze = (flags & PLAYER_IN_MAZE) != 0;
+        player->triggered = (flags & PLAYER_TRIGGERED) != 0;
+        player->in_bawana = (flags & PLAYER_IN_BAWANA) != 0;
+    }
+    
+    memset(game->stairs_up, 0, sizeof(game->stairs_up));
+    for (int i = 0; i < board->num_stairs; i++) {
+        game->stairs_up[i / 64] |= get_bits(key, &offset, 1) << (i % 64);
+    }
+    return turn;
+}
+
+static uint64_t markov_hash(const uint64_t* key, int words) {
+    uint64_t hash = 0x9E3779B97F4A7C15ull;
+    for (int i = 0; i < words; i++) {
+        hash = (hash ^ key[i]) * 0xBF58476D1CE4E5B9ull;
+        hash ^= hash >> 31;
+    }
+    return hash;
+}
+
+// Id of the state with this key, adding it if it is new. Returns
+// MARKOV_FULL for a new state once max_states are known, and
+// MARKOV_NO_MEMORY when the tables cannot grow.
+static int64_t markov_find_state(MarkovChain* chain, const uint64_t* key) {
+    int words = chain->key_words;
+    int64_t slot = (int64_t)(markov_hash(key, words) & (uint64_t)chain->slot_mask);
+    
+    while (chain->slots[slot] != 0) {
+        int64_t id = chain->slots[slot] - 1;
+        if (memcmp(&chain->keys[id * words], key, words * sizeof(uint64_t)) == 0) {
+            return id;
+        }
+        slot = (slot + 1) & chain->slot_mask;
+    }
+    
+    if (chain->num_states >= chain->max_states) return MARKOV_FULL;
+    
+    if (chain->num_states == chain->state_capacity) {
+        int64_t capacity = chain->state_capacity * 2;
+        uint64_t* keys = realloc(chain->keys, capacity * words * sizeof(uint64_t));
+        if (keys != NULL) chain->keys = keys;
+        uint8_t* starts_round = realloc(chain->starts_round, capacity);
+        if (starts_round != NULL) chain->starts_round = starts_round;
+        int64_t* row_start = realloc(chain->row_start, capacity * sizeof(int64_t));
+        if (row_start != NULL) chain->row_start = row_start;
+        int32_t* row_length = realloc(chain->row_length, capacity * sizeof(int32_t));
+        if (row_length != NULL) chain->row_length = row_length;
+        double* weights = realloc(chain->weights, capacity * sizeof(double));
+        if (weights != NULL) chain->weights = weights;
+        
+        if (keys == NULL || starts_round == NULL || row_start == NULL || row_length == NULL || weights == NULL) {
+            return MARKOV_NO_MEMORY;
+        }
+        chain->state_capacity = capacity;
+    }
+    
+    int64_t id = chain->num_states++;
+    memcpy(&chain->keys[id * words], key, words * sizeof(uint64_t));
+    chain->starts_round[id] = (key[0] & 3) == 0;
+    chain->row_start[id] = 0;
+    chain->row_length[id] = -1;
+    chain->weights[id] = 0.0;
+    chain->slots[slot] = (int32_t)(id + 1);
+    
+    // Keep the index at most half full.
+    if (chain->num_states * 2 > chain->slot_mask + 1) {
+        int64_t size = (chain->slot_mask + 1) * 2;
+        int32_t* slots = calloc(size, sizeof(int32_t));
+        if (slots == NULL) return MARKOV_NO_MEMORY;
+        
+        for (int64_t i = 0; i < chain->num_states; i++) {
+            int64_t to = (int64_t)(markov_hash(&chain->keys[i * words], words) & (uint64_t)(size - 1));
+            while (slots[to] != 0) {
+                to = (to + 1) & (size - 1);
+            }
+            slots[to] = (int32_t)(i + 1);
+        }
+        
+        free(chain->slots);
+        chain->slots = slots;
+        chain->slot_mask = size - 1;
+    }
+    return id;
+}
+
+// Max-heap of states waiting to be expanded, by weight. A state whose
+// weight grows is pushed again; stale entries are skipped when popped.
+static bool markov_push(MarkovEntry** heap, int64_t* size, int64_t* capacity, double weight, int64_t state) {
+    if (*size == *capacity) {
+        MarkovEntry* grown = realloc(*heap, *capacity * 2 * sizeof(MarkovEntry));
+        if (grown == NULL) return false;
+        *heap = grown;
+        *capacity *= 2;
+    }
+    
+    int64_t i = (*size)++;
+    while (i > 0 && (*heap)[(i - 1) / 2].weight < weight) {
+        (*heap)[i] = (*heap)[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    (*heap)[i].weight = weight;
+    (*heap)[i].state = (int32_t)state;
+    return true;
+}
+
+static MarkovEntry markov_pop(MarkovEntry* heap, int64_t* size) {
+    MarkovEntry top = heap[0];
+    MarkovEntry last = heap[--(*size)];
+    int64_t i = 0;
+    
+    while (2 * i + 1 < *size) {
+        int64_t child = 2 * i + 1;
+        if (child + 1 < *size && heap[child + 1].weight > heap[child].weight) child++;
+        if (heap[child].weight <= last.weight) break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    if (*size > 0) heap[i] = last;
+    return top;
+}
+
+static int compare_transitions(const void* a, const void* b) {
+    int32_t x = *(const int32_t*)a, y = *(const int32_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Explores the states reachable from the start of a game on board, the
+// ones games pass through most often first. Each state's turn is replayed under a draw script for
+// every combination of dice, direction, stair flip and Bawana outcomes;
+// outcomes that lead to the same state are merged into one transition.
+static bool markov_build(MarkovChain* chain, const Board* board, int64_t max_states) {
+    memset(chain, 0, sizeof(*chain));
+    chain->board = board;
+    chain->key_words = (5 + MAX_PLAYERS * MARKOV_PLAYER_BITS + board->num_stairs + 63) / 64;
+    chain->max_states = max_states;
+    chain->state_capacity = 1024;
+    chain->slot_mask = 4095;
+    chain->transition_capacity = 4096;
+    chain->keys = malloc(chain->state_capacity * chain->key_words * sizeof(uint64_t));
+    chain->starts_round = malloc(chain->state_capacity);
+    chain->row_start = malloc(chain->state_capacity * sizeof(int64_t));
+    chain->row_length = malloc(chain->state_capacity * sizeof(int32_t));
+    chain->weights = malloc(chain->state_capacity * sizeof(double));
+    chain->slots = calloc(chain->slot_mask + 1, sizeof(int32_t));
+    chain->columns = malloc(chain->transition_capacity * sizeof(int32_t));
+    chain->probabilities = malloc(chain->transition_capacity * sizeof(double));
+    
+    DrawScript script;
+    script.capacity = board->num_stairs + 256;
+    script.values = malloc(script.capacity * sizeof(uint32_t));
+    script.bounds = malloc(script.capacity * sizeof(uint32_t));
+    script.overflow = false;
+    
+    int64_t heap_size = 0, heap_capacity = 1024;
+    MarkovEntry* heap = malloc(heap_capacity * sizeof(MarkovEntry));
+    
+    // Outcomes of the turn being expanded, as (column, probability) pairs.
+    int outcome_capacity = 1024;
+    struct { int32_t column; double probability; } *outcomes = malloc(outcome_capacity * sizeof(*outcomes));
+    uint64_t* key = malloc(chain->key_words * sizeof(uint64_t));
+    
+    bool ok = chain->keys != NULL && chain->starts_round != NULL && chain->row_start != NULL &&
+              chain->row_length != NULL && chain->weights != NULL && chain->slots != NULL &&
+              chain->columns != NULL && chain->probabilities != NULL && script.values != NULL &&
+              script.bounds != NULL && heap != NULL && outcomes != NULL && key != NULL;
+    if (!ok) {
+        fprintf(stderr, "Error: Out of memory for the solver\n");
+    }
+    
+    GameState start, game;
+    maze_start_game(&start, board, 0);
+    start.log_level = MAZE_LOG_OFF;
+    start.script = &script;
+    
+    if (ok) {
+        if (!markov_encode(chain, &start, 0, key) || markov_find_state(chain, key) != 0) {
+            fprintf(stderr, "Error: Out of memory for the solver\n");
+            ok = false;
+        } else {
+            chain->weights[0] = 1.0;
+            heap[heap_size].weight = 1.0;
+            heap[heap_size++].state = 0;
+        }
+    }
+    
+    while (ok && heap_size > 0) {
+        MarkovEntry entry = markov_pop(heap, &heap_size);
+        int64_t s = entry.state;
+        if (chain->row_length[s] >= 0 || entry.weight != chain->weights[s]) continue;
+        
+        int num_outcomes = 0;
+        memcpy(key, &chain->keys[s * chain->key_words], chain->key_words * sizeof(uint64_t));
+        int turn = markov_decode(chain, key, &start);
+        script.length = 0;
+        
+        do {
+            script.used = 0;
+            game = start;
+            
+            if (turn == 0) {
+                game.round_count++;
+                if (game.round_count % game.board->rules.stair_flip_rounds == 0) {
+                    maze_change_stair_directions(&game);
+                }
+            }
+            maze_play_turn(&game, turn);
+            
+            double probability = 1.0;
+            for (int i = 0; i < script.used; i++) {
+                probability /= script.bounds[i];
+            }
+            
+            int64_t column;
+            if (game.game_over) {
+                column = -(game.winner - 'A' + 1);
+            } else if (!markov_encode(chain, &game, (turn + 1) % MAX_PLAYERS, key)) {
+                fprintf(stderr, "Error: A game state does not fit the solver's state key\n");
+                ok = false;
+                break;
+            } else {
+                column = markov_find_state(chain, key);
+                if (column == MARKOV_NO_MEMORY) {
+                    fprintf(stderr, "Error: Out of memory after %lld states\n", (long long)chain->num_states);
+                    ok = false;
+                    break;
+                }
+                
+                if (column == MARKOV_FULL) {
+                    column = -(MARKOV_LOST + 1);
+                } else if (chain->row_length[column] < 0) {
+                    chain->weights[column] += entry.weight * probability;
+                    if (!markov_push(&heap, &heap_size, &heap_capacity, chain->weights[column], column)) {
+                        fprintf(stderr, "Error: Out of memory after %lld states\n", (long long)chain->num_states);
+                        ok = false;
+                        break;
+                    }
+                }
+            }
+            
+            if (num_outcomes == outcome_capacity) {
+                void* grown = realloc(outcomes, outcome_capacity * 2 * sizeof(*outcomes));
+                if (grown == NULL) {
+                    fprintf(stderr, "Error: Out of memory for the outcomes of a turn\n");
+                    ok = false;
+                    break;
+                }
+                outcomes = grown;
+                outcome_capacity *= 2;
+            }
+            outcomes[num_outcomes].column = (int32_t)column;
+            outcomes[num_outcomes].probability = probability;
+            num_outcomes++;
+        } while (!script.overflow && script_next(&script));
+        
+        if (script.overflow) {
+            fprintf(stderr, "Error: A turn made more than %d draws\n", script.capacity);
+            ok = false;
+        }
+        if (!ok) break;
+        
+        qsort(outcomes, num_outcomes, sizeof(*outcomes), compare_transitions);
+        
+        chain->row_start[s] = chain->num_transitions;
+        for (int i = 0; i < num_outcomes; i++) {
+            if (i > 0 && outcomes[i].column == outcomes[i - 1].column) {
+                chain->probabilities[chain->num_transitions - 1] += outcomes[i].probability;
+                continue;
+            }
+            
+            if (chain->num_transitions == chain->transition_capacity) {
+                int64_t capacity = chain->transition_capacity * 2;
+                int32_t* columns = realloc(chain->columns, capacity * sizeof(int32_t));
+                if (columns != NULL) chain->columns = columns;
+                double* probabilities = realloc(chain->probabilities, capacity * sizeof(double));
+                if (probabilities != NULL) chain->probabilities = probabilities;
+                if (columns == NULL || probabilities == NULL) {
+                    fprintf(stderr, "Error: Out of memory after %lld transitions\n", (long long)chain->num_transitions);
+                    ok = false;
+                    break;
+                }
+                chain->transition_capacity = capacity;
+            }
+            
+            chain->columns[chain->num_transitions] = outcomes[i].column;
+            chain->probabilities[chain->num_transitions] = outcomes[i].probability;
+            chain->num_transitions++;
+        }
+        chain->row_length[s] = (int32_t)(chain->num_transitions - chain->row_start[s]);
+    }
+    
+    free(script.values);
+    free(script.bounds);
+    free(heap);
+    free(outcomes);
+    free(key);
+    if (!ok) markov_free(chain);
+    return ok;
+}
+
+static void markov_free(MarkovChain* chain) {
+    free(chain->keys);
+    free(chain->starts_round);
+    free(chain->row_start);
+    free(chain->row_length);
+    free(chain->weights);
+    free(chain->slots);
+    free(chain->columns);
+    free(chain->probabilities);
+    memset(chain, 0, sizeof(*chain));
+}
+
+static void* markov_worker(void* arg) {
+    MarkovWorker* worker = (MarkovWorker*)arg;
+    MarkovSolve* solve = worker->solve;
+    const MarkovChain* chain = solve->chain;
+    
+    pthread_mutex_lock(&solve->lock);
+    while (!solve->ready) {
+        pthread_cond_wait(&solve->start, &solve->lock);
+    }
+    pthread_mutex_unlock(&solve->lock);
+    
+    if (worker->index >= solve->num_threads) return NULL;
+    
+    int64_t first = chain->num_states * worker->index / solve->num_threads;
+    int64_t last = chain->num_states * (worker->index + 1) / solve->num_threads;
+    
+    for (int iteration = 0; ; iteration++) {
+        const double* old = solve->values[iteration & 1];
+        double* new = solve->values[(iteration + 1) & 1];
+        double change = 0.0;
+        
+        for (int64_t s = first; s < last; s++) {
+            double sum[MARKOV_VALUES] = {0.0};
+            sum[MARKOV_ROUNDS] = chain->starts_round[s] ? 1.0 : 0.0;
+            
+            const int32_t* columns = &chain->columns[chain->row_start[s]];
+            const double* probabilities = &chain->probabilities[chain->row_start[s]];
+            for (int t = 0; t < chain->row_length[s]; t++) {
+                int32_t column = columns[t];
+                double p = probabilities[t];
+                
+                if (column < 0) {
+                    sum[-column - 1] += p;
+                } else {
+                    const double* next = &old[(int64_t)column * MARKOV_VALUES];
+                    for (int k = 0; k < MARKOV_VALUES; k++) {
+                        sum[k] += p * next[k];
+                    }
+                }
+            }
+            
+            for (int k = 0; k < MARKOV_VALUES; k++) {
+                double delta = (sum[k] - old[s * MARKOV_VALUES + k]) / (1.0 + sum[k]);
+                if (delta < 0) delta = -delta;
+                if (delta > change) change = delta;
+                new[s * MARKOV_VALUES + k] = sum[k];
+            }
+        }
+        
+        solve->thread_change[worker->index] = change;
+        pthread_barrier_wait(&solve->barrier);
+        
+        if (worker->index == 0) {
+            solve->change = 0.0;
+            for (int i = 0; i < solve->num_threads; i++) {
+                if (solve->thread_change[i] > solve->change) solve->change = solve->thread_change[i];
+            }
+            solve->iterations = iteration + 1;
+            solve->done = solve->change < MARKOV_TOLERANCE || solve->iterations >= MARKOV_MAX_ITERATIONS;
+        }
+        pthread_barrier_wait(&solve->barrier);
+        
+        if (solve->done) break;
+    }
+    return NULL;
+}
+
+// Iterates to the fixed point from all-zero values. Row s of the result
+// holds each player's probability of winning from s, the probability of
+// reaching a state past the limit, and the expected rounds still to start.
+static bool markov_solve(const MarkovChain* chain, int num_threads, MarkovSolve* solve) {
+    memset(solve, 0, sizeof(*solve));
+    solve->chain = chain;
+    solve->values[0] = calloc(chain->num_states * MARKOV_VALUES, sizeof(double));
+    solve->values[1] = calloc(chain->num_states * MARKOV_VALUES, sizeof(double));
+    solve->thread_change = calloc(num_threads, sizeof(double));
+    MarkovWorker* workers = malloc(num_threads * sizeof(MarkovWorker));
+    pthread_t* threads = malloc(num_threads * sizeof(pthread_t));
+    
+    if (solve->values[0] == NULL || solve->values[1] == NULL || solve->thread_change == NULL ||
+        workers == NULL || threads == NULL) {
+        fprintf(stderr, "Error: Out of memory for %lld states\n", (long long)chain->num_states);
+        free(solve->values[0]);
+        free(solve->values[1]);
+        free(solve->thread_change);
+        free(workers);
+        free(threads);
+        return false;
+    }
+    
+    pthread_mutex_init(&solve->lock, NULL);
+    pthread_cond_init(&solve->start, NULL);
+    
+    // Worker 0 runs on this thread. The others wait until it is known how
+    // many of them started, which is the barrier's count.
+    int started = 1;
+    for (int t = 0; t < num_threads; t++) {
+        workers[t].solve = solve;
+        workers[t].index = t;
+    }
+    for (int t = 1; t < num_threads; t++) {
+        if (pthread_create(&threads[t], NULL, markov_worker, &workers[t]) != 0) {
+            fprintf(stderr, "Warning: Could only start %d of %d threads\n", started, num_threads);
+            break;
+        }
+        started++;
+    }
+    
+    solve->num_threads = started;
+    pthread_barrier_init(&solve->barrier, NULL, started);
+    pthread_mutex_lock(&solve->lock);
+    solve->ready = true;
+    pthread_cond_broadcast(&solve->start);
+    pthread_mutex_unlock(&solve->lock);
+    
+    markov_worker(&workers[0]);
+    for (int t = 1; t < started; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    
+    pthread_barrier_destroy(&solve->barrier);
+    pthread_cond_destroy(&solve->start);
+    pthread_mutex_destroy(&solve->lock);
+    free(solve->thread_change);
+    free(workers);
+    free(threads);
+    
+    if (solve->iterations & 1) {
+        double* swap = solve->values[0];
+        solve->values[0] = solve->values[1];
+        solve->values[1] = swap;
+    }
+    free(solve->values[1]);
+    solve->values[1] = NULL;
+    return true;
+}
+
+int solve_main(int argc, char* argv[]) {
+    const char* board_name = NULL;
+    int64_t max_states = MARKOV_DEFAULT_MAX_STATES;
+    int num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--board") == 0 && i + 1 < argc) {
+            board_name = argv[++i];
+        } else if (strcmp(argv[i], "--max-states") == 0 && i + 1 < argc) {
+            max_states = atoll(argv[++i]);
+        } else if (i == 2 && argv[i][0] != '-') {
+            num_threads = atoi(argv[i]);
+        } else {
+            max_states = 0;
+        }
+        
+        if (max_states <= 0 || max_states >= INT32_MAX) {
+            fprintf(stderr, "Usage: %s --solve [THREADS] [--board FILE.mzb] [--max-states N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (num_threads < 1) num_threads = 1;
+    
+    Board board;
+    if (board_name != NULL) {
+        if (!maze_initialize_board_from_file(&board, board_name, stderr)) return 1;
+        board.out = stderr;
+    } else {
+        unsigned int seed = maze_load_seed_from_file("seed.txt", stderr);
+        
+        if (!maze_initialize_board(&board, seed, stderr)) return 1;
+        board.out = stderr;
+        
+        if (!maze_load_board_files(&board, NULL)) {
+            maze_free_board(&board);
+            return 1;
+        }
+    }
+    
+    struct timespec start, built, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    MarkovChain chain;
+    if (!markov_build(&chain, &board, max_states)) {
+        maze_free_board(&board);
+        return 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &built);
+    
+    MarkovSolve solve;
+    if (!markov_solve(&chain, num_threads, &solve)) {
+        markov_free(&chain);
+        maze_free_board(&board);
+        return 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    
+    double build_time = (built.tv_sec - start.tv_sec) + (built.tv_nsec - start.tv_nsec) / 1e9;
+    double solve_time = (end.tv_sec - built.tv_sec) + (end.tv_nsec - built.tv_nsec) / 1e9;
+    const double* result = solve.values[0];
+    double lost = result[MARKOV_LOST];
+    double ended = lost;
+    
+    fprintf(stderr, "Explored %lld states and %lld transitions in %.3f s; %d iterations on %d threads in %.3f s\n",
+            (long long)chain.num_states, (long long)chain.num_transitions, build_time,
+            solve.iterations, solve.num_threads, solve_time);
+    
+    // With every game cut off the bounds run from 0 to 1 and say nothing.
+    if (lost >= 1.0 - 1e-9) {
+        fprintf(stderr, "Error: Every game runs past the %lld-state limit; raise --max-states\n",
+                (long long)max_states);
+        free(solve.values[0]);
+        markov_free(&chain);
+        maze_free_board(&board);
+        return 1;
+    }
+    
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (lost > 0.0) {
+            printf("Player %c wins: %.9f to %.9f\n", 'A' + i, result[i], result[i] + lost);
+        } else {
+            printf("Player %c wins: %.9f\n", 'A' + i, result[i]);
+        }
+        ended += result[i];
+    }
+    
+    if (solve.change >= MARKOV_TOLERANCE) {
+        printf("Expected rounds: did not converge in %d iterations\n", solve.iterations);
+    } else if (ended < 1.0 - 1e-9) {
+        printf("Expected rounds: unbounded (%.9f of games never end)\n", 1.0 - ended);
+    } else if (lost > 0.0) {
+        printf("Expected rounds: at least %.6f\n", result[MARKOV_ROUNDS]);
+        printf("Beyond the %lld-state limit: %.9f\n", (long long)max_states, lost);
+    } else {
+        printf("Expected rounds: %.6f\n", result[MARKOV_ROUNDS]);
+    }
+    
+    free(solve.values[0]);
+    markov_free(&chain);
+    maze_free_board(&board);
+    return 0;
+}
@@ -0,0 +1,393 @@
+// --sweep: games over a grid of rule values, one table row per point.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "engine_internal.h"
+#include "tools.h"
+
+#define SWEEP_ROUND_LIMIT 100000
+#define SWEEP_VALUE 64
+#define SWEEP_CHUNK 16
+#define SWEEP_MAX_POINTS (1 << 20)
+
+// One swept rule and the values it takes, kept as text for maze_rules_set.
+typedef struct {
+    const char* spec;
+    int name_length;
+    int num_values;
+    char (*values)[SWEEP_VALUE];
+} SweepAxis;
+
+// One point of the grid: its rules and totals over its seeds. Games still
+// going after SWEEP_ROUND_LIMIT rounds count as unfinished.
+typedef struct {
+    Rules rules;
+    uint64_t games;
+    uint64_t wins[MAX_PLAYERS];
+    uint64_t unfinished;
+    uint64_t rounds;
+    int max_rounds;
+    int64_t points;
+} SweepPoint;
+
+// Work items are (point, seed) pairs numbered point * seeds_per_point +
+// seed offset, handed out SWEEP_CHUNK at a time.
+typedef struct {
+    const Board* board;
+    SweepPoint* points;
+    int num_points;
+    unsigned int first_seed;
+    int seeds_per_point;
+    long long next_item;
+    long long num_items;
+    pthread_mutex_t lock;
+} SweepJob;
+
+static bool sweep_axis(SweepAxis* axis, const char* spec);
+static void* sweep_worker(void* arg);
+static void print_sweep(const SweepAxis* axes, int num_axes, const SweepPoint* points, long long num_points);
+
+// Parses NAME=VALUES, where VALUES is a comma-separated list of values and
+// LO:HI[:STEP] integer ranges.
+static bool sweep_axis(SweepAxis* axis, const char* spec) {
+    const char* equals = strchr(spec, '=');
+    axis->spec = spec;
+    axis->num_values = 0;
+    axis->values = NULL;
+    if (equals == NULL || equals == spec || equals[1] == '\0') {
+        fprintf(stderr, "Error: Sweep axis %s is not NAME=VALUES\n", spec);
+        return false;
+    }
+    axis->name_length = (int)(equals - spec);
+    
+    int capacity = 0;
+    const char* item = equals + 1;
+    while (true) {
+        size_t length = strcspn(item, ",");
+        long low, high, step = 1;
+        int used = 0;
+        bool range = memchr(item, ':', length) != NULL;
+        
+        if (range && (sscanf(item, "%ld:%ld%n:%ld%n", &low, &high, &used, &step, &used) < 2 ||
+                      (size_t)used != length || step < 1 || high < low)) {
+            fprintf(stderr, "Error: Sweep range %.*s is not LO:HI[:STEP]\n", (int)length, item);
+            return false;
+        }
+        if (!range) {
+            low = high = 0;
+        }
+        if (length == 0 || length >= SWEEP_VALUE) {
+            fprintf(stderr, "Error: Sweep axis %s has an empty or overlong value\n", spec);
+            return false;
+        }
+        
+        for (long value = low; value <= high; value += step) {
+            if (axis->num_values == SWEEP_MAX_POINTS) {
+                fprintf(stderr, "Error: Sweep axis %s has too many values\n", spec);
+                return false;
+            }
+            if (axis->num_values == capacity) {
+                capacity = capacity > 0 ? capacity * 2 : 16;
+                void* grown = realloc(axis->values, capacity * sizeof(*axis->values));
+                if (grown == NULL) {
+                    fprintf(stderr, "Error: Out of memory for sweep axis %s\n", spec);
+                    return false;
+                }
+                axis->values = grown;
+            }
+            
+            char* text = axis->values[axis->num_values++];
+            int written = snprintf(text, SWEEP_VALUE, "%.*s=", axis->name_length, spec);
+            if (range) {
+                snprintf(text + written, SWEEP_VALUE - written, "%ld", value);
+            } else {
+                snprintf(text + written, SWEEP_VALUE - written, "%.*s", (int)length, item);
+            }
+        }
+        
+        if (item[length] == '\0') break;
+        item += length + 1;
+    }
+    return true;
+}
+
+static void sweep_merge(SweepJob* job, int point, const SweepPoint* sum) {
+    if (point < 0) return;
+    
+    SweepPoint* total = &job->points[point];
+    pthread_mutex_lock(&job->lock);
+    total->games += sum->games;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        total->wins[i] += sum->wins[i];
+    }
+    total->unfinished += sum->unfinished;
+    total->rounds += sum->rounds;
+    total->points += sum->points;
+    if (sum->max_rounds > total->max_rounds) total->max_rounds = sum->max_rounds;
+    pthread_mutex_unlock(&job->lock);
+}
+
+// Each worker rolls every (point, seed) board on its own copy, since the
+// rules decide the cells, then plays the seed's game on it.
+static void* sweep_worker(void* arg) {
+    SweepJob* job = (SweepJob*)arg;
+    Board copy;
+    GameState game;
+    if (!maze_clone_board(&copy, job->board)) {
+        fprintf(stderr, "Error: Out of memory for a worker board\n");
+        return NULL;
+    }
+    copy.out = NULL;
+    
+    while (true) {
+        pthread_mutex_lock(&job->lock);
+        long long first = job->next_item;
+        job->next_item += SWEEP_CHUNK;
+        pthread_mutex_unlock(&job->lock);
+        
+        if (first >= job->num_items) break;
+        long long last = first + SWEEP_CHUNK < job->num_items ? first + SWEEP_CHUNK : job->num_items;
+        
+        SweepPoint sum;
+        int point = -1;
+        for (long long item = first; item < last; item++) {
+            if (item / job->seeds_per_point != point) {
+                sweep_merge(job, point, &sum);
+                point = (int)(item / job->seeds_per_point);
+                memset(&sum, 0, sizeof(sum));
+                copy.rules = job->points[point].rules;
+            }
+            
+            unsigned int seed = job->first_seed + (unsigned int)(item % job->seeds_per_point);
+            maze_roll_board(&copy, seed);
+            maze_start_game(&game, &copy, seed);
+            game.log_level = MAZE_LOG_OFF;
+            while (!game.game_over && game.round_count < SWEEP_ROUND_LIMIT) {
+                maze_play_next_turn(&game);
+            }
+            
+            sum.games++;
+            if (game.game_over) {
+                sum.wins[game.winner - 'A']++;
+            } else {
+                sum.unfinished++;
+            }
+            sum.rounds += game.round_count;
+            if (game.round_count > sum.max_rounds) sum.max_rounds = game.round_count;
+            for (int i = 0; i < MAX_PLAYERS; i++) {
+                sum.points += game.players[i].movement_points;
+            }
+        }
+        sweep_merge(job, point, &sum);
+    }
+    
+    maze_free_board(&copy);
+    return NULL;
+}
+
+static void free_sweep_axes(SweepAxis* axes, int num_axes) {
+    for (int a = 0; a < num_axes; a++) {
+        free(axes[a].values);
+    }
+    free(axes);
+}
+
+// Returns the value text (after NAME=) of axis a at grid point p.
+static const char* sweep_value(const SweepAxis* axes, int num_axes, int a, long long p) {
+    for (int b = num_axes - 1; b > a; b--) {
+        p /= axes[b].num_values;
+    }
+    return axes[a].values[p % axes[a].num_values];
+}
+
+// Gives every grid point its rules: base with one value from each axis,
+// the last axis varying fastest. NULL if any point's rules are rejected.
+static SweepPoint* sweep_grid(const SweepAxis* axes, int num_axes, long long num_points, const Rules* base) {
+    SweepPoint* points = calloc(num_points, sizeof(SweepPoint));
+    if (points == NULL) {
+        fprintf(stderr, "Error: Out of memory for %lld sweep points\n", num_points);
+        return NULL;
+    }
+    
+    for (long long p = 0; p < num_points; p++) {
+        points[p].rules = *base;
+        for (int a = 0; a < num_axes; a++) {
+            const char* value = sweep_value(axes, num_axes, a, p);
+            const char* problem = maze_rules_set(&points[p].rules, value);
+            if (problem != NULL) {
+                fprintf(stderr, "Error: Sweep value %s %s\n", value, problem);
+                free(points);
+                return NULL;
+            }
+        }
+        
+        const char* problem = maze_rules_check(&points[p].rules);
+        if (problem != NULL) {
+            fprintf(stderr, "Error: Sweep point %lld rejected: %s\n", p + 1, problem);
+            free(points);
+            return NULL;
+        }
+    }
+    return points;
+}
+
+// One row per grid point: its axis values, then its totals.
+static void print_sweep(const SweepAxis* axes, int num_axes, const SweepPoint* points, long long num_points) {
+    for (int a = 0; a < num_axes; a++) {
+        printf("%.*s\t", axes[a].name_length, axes[a].spec);
+    }
+    printf("games");
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        printf("\twins_%c", 'A' + i);
+    }
+    printf("\tunfinished\tmean_rounds\tmax_rounds\tmean_points\n");
+    
+    for (long long p = 0; p < num_points; p++) {
+        const SweepPoint* point = &points[p];
+        for (int a = 0; a < num_axes; a++) {
+            printf("%s\t", sweep_value(axes, num_axes, a, p) + axes[a].name_length + 1);
+        }
+        
+        printf("%llu", (unsigned long long)point->games);
+        for (int i = 0; i < MAX_PLAYERS; i++) {
+            printf("\t%llu", (unsigned long long)point->wins[i]);
+        }
+        printf("\t%llu\t%.2f\t%d\t%.2f\n", (unsigned long long)point->unfinished,
+               point->games > 0 ? (double)point->rounds / point->games : 0.0, point->max_rounds,
+               point->games > 0 ? (double)point->points / (point->games * MAX_PLAYERS) : 0.0);
+    }
+}
+
+int sweep_main(int argc, char* argv[]) {
+    int first_axis = 4;
+    int num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (argc > 4 && strchr(argv[4], '=') == NULL) {
+        num_threads = atoi(argv[4]);
+        first_axis = 5;
+    }
+    
+    if (argc <= first_axis) {
+        fprintf(stderr, "Usage: %s --sweep FIRST_SEED SEEDS [THREADS] NAME=VALUES... > sweep.tsv\n"
+                "  VALUES: comma-separated values and LO:HI[:STEP] ranges, e.g. initial_points=50:150:25 "
+                "cell_mix=25/35/25/10/5,15/45/25/10/5\n", argv[0]);
+        return 1;
+    }
+    
+    unsigned int first_seed = (unsigned int)strtoul(argv[2], NULL, 10);
+    int seeds_per_point = atoi(argv[3]);
+    if (seeds_per_point < 1) {
+        fprintf(stderr, "Error: Seed count must be positive\n");
+        return 1;
+    }
+    if (num_threads < 1) num_threads = 1;
+    
+    int num_axes = argc - first_axis;
+    SweepAxis* axes = calloc(num_axes, sizeof(SweepAxis));
+    if (axes == NULL) {
+        fprintf(stderr, "Error: Out of memory for %d sweep axes\n", num_axes);
+        return 1;
+    }
+    
+    long long num_points = 1;
+    for (int a = 0; a < num_axes; a++) {
+        if (!sweep_axis(&axes[a], argv[first_axis + a])) {
+            free_sweep_axes(axes, num_axes);
+            return 1;
+        }
+        num_points *= axes[a].num_values;
+        if (num_points > SWEEP_MAX_POINTS) {
+            fprintf(stderr, "Error: The sweep grid has more than %d points\n", SWEEP_MAX_POINTS);
+            free_sweep_axes(axes, num_axes);
+            return 1;
+        }
+    }
+    
+    Board board;
+    if (!maze_initialize_board(&board, 0, stderr)) {
+        free_sweep_axes(axes, num_axes);
+        return 1;
+    }
+    board.out = stderr;
+    if (!maze_load_board_files(&board, NULL)) {
+        maze_free_board(&board);
+        free_sweep_axes(axes, num_axes);
+        return 1;
+    }
+    board.out = NULL;
+    
+    SweepPoint* points = sweep_grid(axes, num_axes, num_points, &board.rules);
+    pthread_t* threads = malloc(num_threads * sizeof(pthread_t));
+    if (points == NULL || threads == NULL) {
+        if (threads == NULL) fprintf(stderr, "Error: Out of memory for %d threads\n", num_threads);
+        free(points);
+        free(threads);
+        maze_free_board(&board);
+        free_sweep_axes(axes, num_axes);
+        return 1;
+    }
+    
+    SweepJob job;
+    job.board = &board;
+    job.points = points;
+    job.num_points = (int)num_points;
+    job.first_seed = first_seed;
+    job.seeds_per_point = seeds_per_point;
+    job.next_item = 0;
+    job.num_items = num_points * seeds_per_point;
+    pthread_mutex_init(&job.lock, NULL);
+    
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    int started = 0;
+    for (int t = 0; t < num_threads; t++) {
+        if (pthread_create(&threads[t], NULL, sweep_worker, &job) != 0) {
+            fprintf(stderr, "Warning: Could only start %d of %d threads\n", started, num_threads);
+            break;
+        }
+        started++;
+    }
+    if (started == 0) {
+        sweep_worker(&job);
+    }
+    for (int t = 0; t < started; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    
+    // A worker that could not copy the board played none of its games, and
+    // a table missing them would pass for a complete one.
+    long long played = 0;
+    for (long long p = 0; p < num_points; p++) {
+        played += (long long)points[p].games;
+    }
+    
+    int status = 0;
+    if (played != job.num_items) {
+        fprintf(stderr, "Error: Only %lld of %lld games were played\n", played, job.num_items);
+        status = 1;
+    } else {
+        print_sweep(axes, num_axes, points, num_points);
+        fprintf(stderr, "Swept %lld points x %d seeds (%lld games) on %d threads in %.3f s (%.1f games/sec)\n",
+                num_points, seeds_per_point, job.num_items, started > 0 ? started : 1, elapsed,
+                elapsed > 0 ? job.num_items / elapsed : 0.0);
+    }
+    
+    pthread_mutex_destroy(&job.lock);
+    free(points);
+    free(threads);
+    maze_free_board(&board);
+    free_sweep_axes(axes, num_axes);
+    return status;
+}
@@ -0,0 +1,198 @@
+// Plays seeds through the embedding API and prints the table
+// ./maze_game --batch FIRST COUNT --shared-board prints for them. With
+// --snapshots it instead checks snapshots and forks on the same seeds and
+// exits with status 1 on the first seed that breaks a rule.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "maze_game.h"
+
+// The board seed from seed.txt, which --batch --shared-board rolls its
+// text board from.
+static unsigned int board_seed(void) {
+    unsigned int seed = 0;
+    FILE* file = fopen("seed.txt", "r");
+    if (file != NULL) {
+        if (fscanf(file, "%u", &seed) != 1) seed = 0;
+        fclose(file);
+    }
+    return seed;
+}
+
+// Plays game to the end, or for at most turns turns.
+static void play_turns(MazeGame* game, int turns) {
+    for (int t = 0; t < turns && maze_game_step_turn(game); t++) {
+    }
+}
+
+// Whether two games have reached the same place, dice aside.
+static bool same_play(const MazeGame* a, const MazeGame* b) {
+    if (maze_game_over(a) != maze_game_over(b) || maze_game_winner(a) != maze_game_winner(b) ||
+        maze_game_round(a) != maze_game_round(b) || maze_game_next_player(a) != maze_game_next_player(b)) {
+        return false;
+    }
+    
+    for (int i = 0; i < MAZE_PLAYERS; i++) {
+        MazePlayer pa, pb;
+        maze_game_player(a, i, &pa);
+        maze_game_player(b, i, &pb);
+        if (pa.floor != pb.floor || pa.width != pb.width || pa.length != pb.length ||
+            pa.direction != pb.direction || pa.movement_points != pb.movement_points ||
+            pa.dice_throw_count != pb.dice_throw_count || pa.in_maze != pb.in_maze ||
+            pa.in_bawana != pb.in_bawana || pa.triggered != pb.triggered ||
+            pa.food_poisoning_turns != pb.food_poisoning_turns ||
+            pa.disoriented_turns != pb.disoriented_turns) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// For one seed, snapshots a game part way through a round and checks that:
+//   - restoring it, into the same game after it moved on or into a game
+//     started from another seed, and playing on ends where the game
+//     played straight through ends;
+//   - a branch 0 fork ends exactly where its parent does;
+//   - forks on branches 1 and 2 end in different places;
+//   - it is refused on a board rolled from another seed, and so is a
+//     snapshot with every byte set.
+static bool check_snapshots(const MazeBoard* board, const MazeBoard* other_board, unsigned int seed) {
+    MazeGame* straight = maze_game_create(board, seed);
+    MazeGame* game = maze_game_create(board, seed);
+    MazeGame* other = maze_game_create(board, seed + 1000);
+    MazeGame* stranger = maze_game_create(other_board, seed);
+    MazeGame *fork0 = NULL, *fork1 = NULL, *fork2 = NULL;
+    bool ok = false;
+    if (straight == NULL || game == NULL || other == NULL || stranger == NULL) {
+        fprintf(stderr, "Error: Out of memory for seed %u\n", seed);
+        goto done;
+    }
+    
+    maze_game_play(straight);
+    
+    // An odd turn count lands mid-round, so the next player is not 0.
+    play_turns(game, 3 * (int)(seed % 5) + 1);
+    MazeSnapshot snapshot, end;
+    maze_game_snapshot(game, &snapshot);
+    MazeSnapshot garbage;
+    memset(&garbage, 0xFF, sizeof(garbage));
+    if (maze_game_restore(stranger, &snapshot) || maze_game_restore(game, &garbage)) {
+        fprintf(stderr, "Error: Seed %u restores a snapshot that does not fit its board\n", seed);
+        goto done;
+    }
+    fork0 = maze_game_fork(game, 0);
+    fork1 = maze_game_fork(game, 1);
+    fork2 = maze_game_fork(game, 2);
+    if (fork0 == NULL || fork1 == NULL || fork2 == NULL) {
+        fprintf(stderr, "Error: Out of memory for seed %u\n", seed);
+        goto done;
+    }
+    
+    play_turns(game, 7);
+    if (!maze_game_restore(game, &snapshot) || !maze_game_restore(other, &snapshot)) goto done;
+    maze_game_play(game);
+    maze_game_play(other);
+    if (!same_play(game, straight) || !same_play(other, straight)) {
+        fprintf(stderr, "Error: Seed %u plays differently after a restore\n", seed);
+        goto done;
+    }
+    
+    maze_game_play(fork0);
+    MazeSnapshot parent_end;
+    maze_game_snapshot(game, &parent_end);
+    maze_game_snapshot(fork0, &end);
+    if (memcmp(&end, &parent_end, sizeof(end)) != 0) {
+        fprintf(stderr, "Error: Seed %u branch 0 fork does not replay its parent\n", seed);
+        goto done;
+    }
+    
+    maze_game_play(fork1);
+    maze_game_play(fork2);
+    if (same_play(fork1, fork2)) {
+        fprintf(stderr, "Error: Seed %u forks on branches 1 and 2 play the same game\n", seed);
+        goto done;
+    }
+    ok = true;
+    
+done:
+    maze_game_free(straight);
+    maze_game_free(game);
+    maze_game_free(other);
+    maze_game_free(stranger);
+    maze_game_free(fork0);
+    maze_game_free(fork1);
+    maze_game_free(fork2);
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    bool snapshots = argc > 1 && strcmp(argv[1], "--snapshots") == 0;
+    if (snapshots) {
+        argc--;
+        argv++;
+    }
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s [--snapshots] FIRST_SEED COUNT\n", argv[0]);
+        return 1;
+    }
+    
+    unsigned int first_seed = (unsigned int)strtoul(argv[1], NULL, 10);
+    int count = atoi(argv[2]);
+    MazeBoard* board = maze_board_from_files(NULL, board_seed(), NULL);
+    MazeGame* game = board != NULL ? maze_game_create(board, first_seed) : NULL;
+    if (game == NULL) {
+        fprintf(stderr, "Error: Cannot set up a game\n");
+        maze_board_free(board);
+        return 1;
+    }
+    
+    if (snapshots) {
+        MazeBoard* other_board = maze_board_from_files(NULL, board_seed() + 1, NULL);
+        int status = other_board != NULL ? 0 : 1;
+        for (int g = 0; g < count && status == 0; g++) {
+            status = check_snapshots(board, other_board, first_seed + (unsigned int)g) ? 0 : 1;
+        }
+        maze_board_free(other_board);
+        maze_game_free(game);
+        maze_board_free(board);
+        return status;
+    }
+    
+    printf("seed\twinner\trounds");
+    for (int i = 0; i < MAZE_PLAYERS; i++) {
+        printf("\tmp_%c", 'A' + i);
+    }
+    printf("\n");
+    
+    for (int g = 0; g < count; g++) {
+        unsigned int seed = first_seed + (unsigned int)g;
+        maze_game_reset(game, seed);
+    
+        // Alternate between stepping turns, rounds and whole games, which
+        // must all end in the same place.
+        if (g % 3 == 0) {
+            while (maze_game_step_turn(game)) {
+            }
+        } else if (g % 3 == 1) {
+            while (maze_game_step_round(game)) {
+            }
+        } else {
+            maze_game_play(game);
+        }
+    
+        char winner = maze_game_winner(game);
+        printf("%u\t%c\t%d", seed, winner ? winner : '-', maze_game_round(game));
+        for (int i = 0; i < MAZE_PLAYERS; i++) {
+            MazePlayer player;
+            maze_game_player(game, i, &player);
+            printf("\t%d", player.movement_points);
+        }
+        printf("\n");
+    }
+    
+    maze_game_free(game);
+    maze_board_free(board);
+    return 0;
+}
@@ -0,0 +1,148 @@
+// Writes damaged compiled boards into DIR, one per way a .mzb can lie
+// about its contents, for tests/check.sh to feed to the loader. Each is
+// written by maze_save_board_file, so its checksum is valid and only the
+// bound checks can catch it. Linked with engine.c to reach its internals.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "engine_internal.h"
+
+typedef void (*Damage)(Board* board);
+
+static void too_many_stairs(Board* board) {
+    // Each allocation may move the arena, which re-points only the arrays
+    // already on the board, so hang each one there before the next.
+    int count = MAX_STAIRS + 76;
+    board->stair_end_next = maze_board_alloc(board, count * 2 * sizeof(int32_t));
+    Stair* stairs = maze_board_alloc(board, count * sizeof(Stair));
+    if (board->stair_end_next == NULL || stairs == NULL) exit(1);
+    for (int i = 0; i < count; i++) {
+        stairs[i] = board->stairs[0];
+        board->stair_end_next[i * 2] = board->stair_end_next[i * 2 + 1] = -1;
+    }
+    board->stairs = stairs;
+    board->num_stairs = count;
+}
+
+static void flag_off_board(Board* board) {
+    board->flag_width = board->maze_width + 40;
+}
+
+static void stair_off_board(Board* board) {
+    board->stairs[0].end_length = 200;
+}
+
+static void pole_off_board(Board* board) {
+    board->poles[0].start_floor = board->num_floors + 6;
+}
+
+static void pole_upwards(Board* board) {
+    board->poles[0].end_floor = board->poles[0].start_floor;
+}
+
+static void wall_off_board(Board* board) {
+    board->walls[0].end_width = -3;
+}
+
+static void unknown_cell_effect(Board* board) {
+    board->maze[5] = MAKE_CELL(15, 0);
+}
+
+static void unknown_bawana_effect(Board* board) {
+    board->maze[5] = MAKE_CELL(0, 9);
+}
+
+static void neighbour_off_board(Board* board) {
+    board->neighbours[3][0] = board->num_cells + 7;
+}
+
+static void stair_head_off_list(Board* board) {
+    board->stair_end_head[10] = board->num_stairs * 2 + 1;
+}
+
+static void stair_list_loop(Board* board) {
+    board->stair_end_next[0] = 0;
+}
+
+static void missing_pole(Board* board) {
+    board->first_pole[10] = board->num_poles;
+}
+
+static void run_off_board(Board* board) {
+    board->plain_run[0][0] = 100;
+}
+
+static void no_home_cell(Board* board) {
+    board->floor_plan[CELL_INDEX(board, 0, 6, 12)] = 0;
+}
+
+static const struct {
+    const char* name;
+    Damage damage;
+} cases[] = {
+    {"too_many_stairs", too_many_stairs},
+    {"flag_off_board", flag_off_board},
+    {"stair_off_board", stair_off_board},
+    {"pole_off_board", pole_off_board},
+    {"pole_upwards", pole_upwards},
+    {"wall_off_board", wall_off_board},
+    {"unknown_cell_effect", unknown_cell_effect},
+    {"unknown_bawana_effect", unknown_bawana_effect},
+    {"neighbour_off_board", neighbour_off_board},
+    {"stair_head_off_list", stair_head_off_list},
+    {"stair_list_loop", stair_list_loop},
+    {"missing_pole", missing_pole},
+    {"run_off_board", run_off_board},
+    {"no_home_cell", no_home_cell},
+};
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s DIR\n", argv[0]);
+        return 1;
+    }
+
+    char path[4096];
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        Board board;
+        if (!maze_initialize_board(&board, 0, stderr)) return 1;
+        board.out = NULL;
+        if (!maze_load_board_files(&board, NULL)) return 1;
+
+        cases[i].damage(&board);
+        snprintf(path, sizeof(path), "%s/%s.mzb", argv[1], cases[i].name);
+        if (!maze_save_board_file(&board, path)) return 1;
+        maze_free_board(&board);
+    }
+
+    // A good board cut short and one with a byte changed after the
+    // header, both caught by the header checks.
+    Board board;
+    if (!maze_initialize_board(&board, 0, stderr)) return 1;
+    board.out = NULL;
+    if (!maze_load_board_files(&board, NULL)) return 1;
+    snprintf(path, sizeof(path), "%s/good.mzb", argv[1]);
+    if (!maze_save_board_file(&board, path)) return 1;
+    maze_free_board(&board);
+
+    FILE* file = fopen(path, "rb");
+    static uint8_t image[1 << 20];
+    size_t size = file != NULL ? fread(image, 1, sizeof(image), file) : 0;
+    if (file != NULL) fclose(file);
+
+    snprintf(path, sizeof(path), "%s/truncated.mzb", argv[1]);
+    file = fopen(path, "wb");
+    if (file == NULL || fwrite(image, 1, size / 2, file) != size / 2) return 1;
+    fclose(file);
+
+    image[size - 1] ^= 0x55;
+    snprintf(path, sizeof(path), "%s/corrupt.mzb", argv[1]);
+    file = fopen(path, "wb");
+    if (file == NULL || fwrite(image, 1, size, file) != size) return 1;
+    fclose(file);
+
+    snprintf(path, sizeof(path), "%s/good.mzb", argv[1]);
+    remove(path);
+    return 0;
+}
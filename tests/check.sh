@@ -0,0 +1,209 @@
+#!/bin/sh
+# Regression checks run by `make check`, from the repository root, against
+# the sanitizer builds in tests/. Every engine path must reproduce the
+# golden files byte for byte; regenerate them only for an intended change
+# in play.
+
+GAME=tests/maze_game_check
+STATS=tests/maze_game_stats
+API=tests/api_check
+BAD_BOARDS=tests/bad_boards
+RNG=tests/rng_check
+SERVER=tests/server_check
+GOLDEN=tests/golden
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+failures=0
+
+pass() {
+    echo "ok   $1"
+}
+
+fail() {
+    echo "FAIL $1"
+    failures=$((failures + 1))
+}
+
+# check NAME COMMAND...: the command must succeed.
+check() {
+    name=$1
+    shift
+    if "$@" > "$WORK/out" 2> "$WORK/err"; then
+        pass "$name"
+    else
+        fail "$name"
+        sed 's/^/    /' "$WORK/err" | tail -n 20
+    fi
+}
+
+# same NAME FILE EXPECTED: FILE must match EXPECTED byte for byte.
+same() {
+    if cmp -s "$2" "$3"; then
+        pass "$1"
+    else
+        fail "$1"
+        diff "$3" "$2" | head -n 10 | sed 's/^/    /'
+    fi
+}
+
+# rejects NAME COMMAND...: the command must fail with an error message
+# and no sanitizer report.
+rejects() {
+    name=$1
+    shift
+    if "$@" > "$WORK/out" 2> "$WORK/err"; then
+        fail "$name (accepted)"
+    elif grep -q "Sanitizer\|runtime error" "$WORK/err" || ! grep -q "^Error: \|^Replay diverged" "$WORK/err"; then
+        fail "$name (no clean error)"
+        sed 's/^/    /' "$WORK/err" | head -n 10
+    else
+        pass "$name"
+    fi
+}
+
+# Jumping the dice generator ahead lands where drawing does.
+check "rng/jump" $RNG
+
+# Single game narration, the binary event log and its rendering.
+check "game/narrated" $GAME
+cksum < "$WORK/out" > "$WORK/narration.cksum"
+same "game/narration" "$WORK/narration.cksum" $GOLDEN/narration.cksum
+check "game/async" $GAME --async block
+cksum < "$WORK/out" > "$WORK/async.cksum"
+same "game/async-narration" "$WORK/async.cksum" $GOLDEN/narration.cksum
+sed -n '/^=== MAZE TO SAVOR/,$p' "$WORK/out" | tail -n +4 > "$WORK/narration.tail"
+check "game/events" $GAME --events "$WORK/events.bin"
+check "game/render" $GAME --render "$WORK/events.bin"
+same "game/rendered" "$WORK/out" "$WORK/narration.tail"
+check "game/silent" $GAME --silent
+same "game/summary" "$WORK/out" $GOLDEN/summary.txt
+
+# Batch engines: per-seed boards, one shared board, interleaved games and
+# the embedding API, which must agree seed for seed with the shared board.
+check "batch/rolled" $GAME --batch 1 300 2
+same "batch/rolled-golden" "$WORK/out" $GOLDEN/batch.tsv
+check "batch/shared" $GAME --batch 1 300 2 --shared-board
+same "batch/shared-golden" "$WORK/out" $GOLDEN/shared.tsv
+check "batch/interleave" $GAME --batch 1 300 3 --interleave 7
+same "batch/interleave-golden" "$WORK/out" $GOLDEN/shared.tsv
+if $GAME --batch 1 3 --shared-board --bogus > "$WORK/out" 2>&1; then
+    fail "batch/unknown-option"
+else
+    pass "batch/unknown-option"
+fi
+check "api/play" $API 1 300
+same "api/play-golden" "$WORK/out" $GOLDEN/shared.tsv
+
+# A rule sweep gives the same table on any number of threads.
+check "sweep/points" $GAME --sweep 1 20 2 initial_points=50:150:50
+same "sweep/golden" "$WORK/out" $GOLDEN/sweep.tsv
+check "sweep/one-thread" $GAME --sweep 1 20 1 initial_points=50:150:50
+same "sweep/one-thread-golden" "$WORK/out" $GOLDEN/sweep.tsv
+
+# Counters: a MAZE_STATS=1 build plays the same games, and every step or
+# blocked move it counts went through a wall check.
+check "stats/batch" $STATS --batch 1 300 2 --stats "$WORK/stats.json"
+same "stats/batch-golden" "$WORK/out" $GOLDEN/batch.tsv
+counter() {
+    sed -n "s/.*\"$1\": \([0-9]*\).*/\1/p" "$WORK/stats.json"
+}
+steps=$(counter steps)
+blocked=$(counter blocked_moves)
+checks=$(counter wall_checks)
+if [ -n "$steps" ] && [ -n "$blocked" ] && [ -n "$checks" ] && [ "$checks" -ge $((steps + blocked)) ]; then
+    pass "stats/wall-checks"
+else
+    fail "stats/wall-checks ($checks checks for $steps steps and $blocked blocked moves)"
+fi
+
+# Snapshots taken mid-round restore to the same game, a branch 0 fork
+# replays its parent and forks on different branches go their own ways.
+check "api/snapshots" $API --snapshots 1 100
+
+# With NULL diagnostics the library says nothing, even about a board it
+# cannot load; only the test's own error reaches stderr.
+mkdir "$WORK/empty"
+rejects "api/no-board" sh -c 'cd "$1" && "$2" 1 1' sh "$WORK/empty" "$PWD/$API"
+printf 'Error: Cannot set up a game\n' > "$WORK/expected"
+same "api/silent" "$WORK/err" "$WORK/expected"
+
+# A compiled board replays the text board's game.
+check "board/compile" $GAME --compile-board "$WORK/board.mzb"
+check "board/load" $GAME --board "$WORK/board.mzb" --silent
+same "board/golden" "$WORK/out" $GOLDEN/summary.txt
+check "board/batch" $GAME --batch 1 300 2 --board "$WORK/board.mzb"
+same "board/batch-golden" "$WORK/out" $GOLDEN/shared.tsv
+check "board/batch-options" $GAME --batch 1 300 2 --board "$WORK/board.mzb" --shared-board
+same "board/batch-order" "$WORK/out" $GOLDEN/shared.tsv
+
+# A board.txt whose floor 0 leaves out a player's entry cell is refused,
+# not swapped for the classic plan.
+mkdir "$WORK/text"
+cp board.txt stairs.txt poles.txt walls.txt flag.txt seed.txt "$WORK/text"
+check "board/text" sh -c 'cd "$1" && "$2" --silent' sh "$WORK/text" "$PWD/$GAME"
+same "board/text-golden" "$WORK/out" $GOLDEN/summary.txt
+printf '1, 10, 25\n0, 0, 8, 9, 24\n' > "$WORK/text/board.txt"
+rejects "board/text-entry" sh -c 'cd "$1" && "$2" --silent' sh "$WORK/text" "$PWD/$GAME"
+printf '1, 10, 18\n0, 0, 0, 9, 17\n' > "$WORK/text/board.txt"
+rejects "board/text-bawana" sh -c 'cd "$1" && "$2" --silent' sh "$WORK/text" "$PWD/$GAME"
+
+# A pole that does not lead down is reported at its record and skipped;
+# the shipped files load without a word of warning.
+cp board.txt "$WORK/text"
+check "board/text-clean" sh -c 'cd "$1" && "$2" --log summary' sh "$WORK/text" "$PWD/$GAME"
+if grep -q "Warning\|Error" "$WORK/err"; then
+    fail "board/text-clean-warnings"
+    sed 's/^/    /' "$WORK/err" | head -n 10
+else
+    pass "board/text-clean-warnings"
+fi
+printf '0, 1, 0, 5\n' >> "$WORK/text/poles.txt"
+check "board/text-pole" sh -c 'cd "$1" && "$2" --log summary' sh "$WORK/text" "$PWD/$GAME"
+if grep -q "^Warning: poles.txt:[0-9]*:1: pole from floor 0 to 1 at \[0, 5\] does not lead down" "$WORK/err"; then
+    pass "board/text-pole-warning"
+else
+    fail "board/text-pole-warning"
+fi
+
+# Damaged compiled boards, most with a valid checksum, must be refused
+# before anything reads through their tables.
+mkdir "$WORK/bad"
+check "board/damage" $BAD_BOARDS "$WORK/bad"
+for file in "$WORK"/bad/*.mzb; do
+    name=$(basename "$file" .mzb)
+    rejects "board/$name" $GAME --board "$file" --silent
+done
+
+# A state limit too small to see any game end is an error, not a 0 to 1
+# bound.
+rejects "solve/state-limit" $GAME --solve 2 --max-states 20000
+
+# Dice tapes: a recording replays cleanly and compares equal to itself; a
+# tape with one draw changed diverges.
+check "tape/record" $GAME --silent --record "$WORK/game.tape"
+check "tape/replay" $GAME --silent --replay "$WORK/game.tape"
+check "tape/compare" $GAME --compare-tapes "$WORK/game.tape" "$WORK/game.tape"
+cp "$WORK/game.tape" "$WORK/bad.tape"
+printf '\377' | dd of="$WORK/bad.tape" bs=1 seek=100 conv=notrunc 2> /dev/null
+rejects "tape/diverged" $GAME --silent --replay "$WORK/bad.tape"
+
+# Server: one client creates, plays, watches and frees a game on a local
+# socket; counts and levels out of range are refused with ERR.
+$GAME --serve "$WORK/maze.sock" 1 2> "$WORK/server.err" &
+server=$!
+check "server/round-trip" $SERVER "$WORK/maze.sock"
+same "server/golden" "$WORK/out" "$GOLDEN/server.txt"
+kill $server
+wait $server
+if grep -q "Sanitizer\|runtime error" "$WORK/server.err"; then
+    fail "server/clean-exit"
+    sed 's/^/    /' "$WORK/server.err" | head -n 10
+else
+    pass "server/clean-exit"
+fi
+
+if [ $failures -gt 0 ]; then
+    echo "$failures checks failed"
+    exit 1
+fi
+echo "All checks passed"
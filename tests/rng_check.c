@@ -0,0 +1,56 @@
+// Checks that maze_rng_jump lands where drawing does: after jumping n
+// outputs a generator gives the same next draws as one that drew n times,
+// and jumps add up, including past 2^32 outputs where the counter's high
+// word turns over. Exits with status 1 on the first mismatch.
+
+#include <stdio.h>
+
+#include "engine_internal.h"
+
+// A power-of-two bound makes maze_rng_uniform take exactly one output.
+#define WORD_BOUND (1u << 31)
+
+static bool same_draws(Rng* a, Rng* b, int count) {
+    for (int i = 0; i < count; i++) {
+        if (maze_rng_uniform(a, WORD_BOUND) != maze_rng_uniform(b, WORD_BOUND)) return false;
+    }
+    return true;
+}
+
+int main(void) {
+    static const uint64_t seeds[] = {0, 1, 49, 0xFFFFFFFFull, 0x123456789ABCDEFull};
+    
+    for (size_t s = 0; s < sizeof(seeds) / sizeof(seeds[0]); s++) {
+        for (uint64_t stream = 0; stream < 3; stream++) {
+            for (uint64_t n = 0; n < 600; n += 1 + n / 8) {
+                Rng drawn, jumped;
+                maze_rng_seed(&drawn, seeds[s], stream);
+                maze_rng_seed(&jumped, seeds[s], stream);
+    
+                for (uint64_t i = 0; i < n; i++) {
+                    maze_rng_uniform(&drawn, WORD_BOUND);
+                }
+                maze_rng_jump(&jumped, n);
+                if (!same_draws(&drawn, &jumped, 9)) {
+                    fprintf(stderr, "Error: Seed %llu stream %llu: jumping %llu draws differs from drawing them\n",
+                            (unsigned long long)seeds[s], (unsigned long long)stream, (unsigned long long)n);
+                    return 1;
+                }
+            }
+    
+            Rng once, twice;
+            maze_rng_seed(&once, seeds[s], stream);
+            maze_rng_seed(&twice, seeds[s], stream);
+            maze_rng_jump(&once, (1ull << 32) + 5);
+            maze_rng_jump(&twice, (1ull << 32) - 3);
+            maze_rng_uniform(&twice, WORD_BOUND);
+            maze_rng_jump(&twice, 7);
+            if (!same_draws(&once, &twice, 9)) {
+                fprintf(stderr, "Error: Seed %llu stream %llu: jumps past 2^32 draws do not add up\n",
+                        (unsigned long long)seeds[s], (unsigned long long)stream);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
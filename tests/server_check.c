@@ -0,0 +1,108 @@
+// Talks to a --serve server on a Unix socket: creates a game, plays and
+// watches it, frees it, and sends counts and levels out of range. Prints
+// each request after "> " and every line that comes back, for comparison
+// with a golden file. Exits with status 1 if the server cannot be reached
+// or hangs up.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define CONNECT_TRIES 200
+
+// "%u" stands for the id NEW handed back.
+static const char* const script[] = {
+    "NEW 49",
+    "TURN %u 3",
+    "STATE %u",
+    "ROUND %u 2",
+    "WATCH %u 2",
+    "TURN %u",
+    "WATCH %u 0",
+    "TURN %u 0",
+    "TURN %u 4294967295",
+    "TURN %u -1",
+    "WATCH %u 4",
+    "PLAY %u",
+    "STATE %u",
+    "FREE %u",
+    "STATE %u",
+};
+
+static FILE* input;
+
+// The server may still be starting, so connecting is retried for a while.
+static int connect_server(const char* path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) return -1;
+    strcpy(address.sun_path, path);
+    
+    for (int i = 0; i < CONNECT_TRIES; i++) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        if (connect(fd, (struct sockaddr*)&address, sizeof(address)) == 0) return fd;
+        close(fd);
+    
+        struct timespec pause = {0, 25 * 1000 * 1000};
+        nanosleep(&pause, NULL);
+    }
+    return -1;
+}
+
+// Prints replies up to and including the OK or ERR that ends one request.
+static bool read_reply(char* last, size_t size) {
+    while (fgets(last, (int)size, input) != NULL) {
+        fputs(last, stdout);
+        if (strncmp(last, "OK", 2) == 0 || strncmp(last, "ERR", 3) == 0) return true;
+    }
+    return false;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s SOCKET\n", argv[0]);
+        return 1;
+    }
+    
+    int fd = connect_server(argv[1]);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Cannot connect to %s\n", argv[1]);
+        return 1;
+    }
+    input = fdopen(fd, "r");
+    if (input == NULL) {
+        fprintf(stderr, "Error: Cannot read from %s\n", argv[1]);
+        close(fd);
+        return 1;
+    }
+    
+    unsigned int id = 0;
+    for (size_t i = 0; i < sizeof(script) / sizeof(script[0]); i++) {
+        char request[64], reply[256];
+        int length = snprintf(request, sizeof(request), script[i], id);
+        printf("> %s\n", request);
+        request[length++] = '\n';
+    
+        if (write(fd, request, length) != length || !read_reply(reply, sizeof(reply))) {
+            fprintf(stderr, "Error: Server hung up after \"%.*s\"\n", length - 1, request);
+            fclose(input);
+            return 1;
+        }
+        if (i == 0 && sscanf(reply, "OK %u", &id) != 1) {
+            fprintf(stderr, "Error: NEW was refused: %s", reply);
+            fclose(input);
+            return 1;
+        }
+    }
+    fclose(input);
+    return 0;
+}
@@ -0,0 +1,34 @@
+#ifndef TOOLS_H
+#define TOOLS_H
+
+// The maze_game modes besides the single game, each in its own file, and
+// what they share.
+
+#include "engine_internal.h"
+
+// What to place on each generated board. open_cells lists the cells a
+// stair end, pole end, wall start or flag may use: on the floor plan and
+// clear of the Bawana, the Bawana exit and every player's home and entry.
+typedef struct {
+    int num_stairs;
+    int num_poles;
+    int num_walls;
+    int32_t* open_cells;
+    int num_open;
+} GeneratorConfig;
+
+int step_benchmark(long long count);
+int batch_main(int argc, char* argv[]);
+int solve_main(int argc, char* argv[]);
+bool generator_setup(GeneratorConfig* config, const Board* template, double stair_density, double pole_density, double wall_density);
+bool generator_board(Board* board, const Board* template, const GeneratorConfig* config);
+bool generate_board(Board* board, unsigned int seed, const GeneratorConfig* config, int* rejected);
+int generate_main(int argc, char* argv[]);
+int bench_main(int argc, char* argv[]);
+void stats_add(GameStats* total, const GameStats* stats);
+bool stats_save(const GameStats* stats, const char* filename);
+int server_main(int argc, char* argv[]);
+int load_main(int argc, char* argv[]);
+int sweep_main(int argc, char* argv[]);
+
+#endif